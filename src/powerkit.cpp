@@ -45,10 +45,22 @@ int main(int argc, char *argv[])
         dialog.show();
         return a.exec();
     } else if (setBrightness) {
-        int val = PowerKit::Backlight::getCurrentBrightness();
-        if (args.contains(CMD_OPT_BRIGHTNESS_UP)) { val += POWERKIT_BACKLIGHT_STEP; }
-        else if (args.contains(CMD_OPT_BRIGHTNESS_DOWN)) { val -= POWERKIT_BACKLIGHT_STEP; }
-        return PowerKit::Backlight::setBrightness(val);
+        bool up = args.contains(CMD_OPT_BRIGHTNESS_UP);
+        // let the session animate and coalesce repeated hotkeys
+        QDBusInterface manager(POWERKIT_SERVICE,
+                               POWERKIT_PATH,
+                               POWERKIT_MANAGER,
+                               QDBusConnection::sessionBus());
+        if (up && PowerKit::Client::brightnessUp(&manager)) { return 1; }
+        if (!up && PowerKit::Client::brightnessDown(&manager)) { return 1; }
+        const QString device = PowerKit::Backlight::getDevice();
+        int val = PowerKit::Backlight::toPercent(device,
+                                                 PowerKit::Backlight::getCurrentBrightness(device));
+        val += up ? POWERKIT_BACKLIGHT_STEP : -POWERKIT_BACKLIGHT_STEP;
+        // about to exit, wait for logind
+        return PowerKit::Backlight::setBrightness(device,
+                                                  PowerKit::Backlight::fromPercent(device, val),
+                                                  false);
     } else if (setSleep || setHibernate || setLock) {
         QDBusInterface manager(POWERKIT_SERVICE,
                                POWERKIT_PATH,
@@ -0,0 +1,185 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "powerkit_ambient.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+
+#include <cmath>
+
+#define PK_IIO_PATH "/sys/bus/iio/devices"
+#define PK_IIO_INPUT "in_illuminance_input"
+#define PK_IIO_RAW "in_illuminance_raw"
+#define PK_IIO_SCALE "in_illuminance_scale"
+#define PK_IIO_OFFSET "in_illuminance_offset"
+
+#define PK_AMBIENT_INTERVAL_MIN 500 // msec
+#define PK_AMBIENT_INTERVAL_MAX 5000 // msec
+#define PK_AMBIENT_SMOOTHING 0.3 // weight of a new sample
+#define PK_AMBIENT_STABLE 0.05 // log10 lux, counts as unchanged
+#define PK_AMBIENT_HYSTERESIS 5 // %
+#define PK_AMBIENT_MAX_LUX 10000.0 // direct daylight
+#define PK_AMBIENT_MIN_PERCENT 5
+
+using namespace PowerKit;
+
+static double readNumber(const QString &path, double fallback)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) { return fallback; }
+    bool ok = false;
+    double value = file.readAll().trimmed().toDouble(&ok);
+    return ok ? value : fallback;
+}
+
+AmbientLight::AmbientLight(QObject *parent)
+    : QObject(parent)
+    , scale(1.0)
+    , offset(0.0)
+    , enabled(false)
+    , paused(false)
+    , filtered(-1.0)
+    , applied(-1)
+    , base(-1)
+    , userOffset(0)
+{
+    sensor = findSensor();
+    if (!sensor.isEmpty()) {
+        // processed input is already in lux, raw needs offset and scale
+        if (QFileInfo::exists(QString("%1/%2").arg(sensor, PK_IIO_INPUT))) {
+            input = QString("%1/%2").arg(sensor, PK_IIO_INPUT);
+        } else {
+            input = QString("%1/%2").arg(sensor, PK_IIO_RAW);
+            scale = readNumber(QString("%1/%2").arg(sensor, PK_IIO_SCALE), 1.0);
+            offset = readNumber(QString("%1/%2").arg(sensor, PK_IIO_OFFSET), 0.0);
+        }
+    }
+    qDebug() << "ambient light sensor" << input << scale << offset;
+
+    sampleTimer.setSingleShot(true);
+    connect(&sampleTimer, SIGNAL(timeout()),
+            this, SLOT(sample()));
+}
+
+const QString AmbientLight::findSensor()
+{
+    QDir dir(PK_IIO_PATH);
+    const QStringList devices = dir.entryList(QDir::Dirs | QDir::System | QDir::NoDotAndDotDot,
+                                              QDir::Name);
+    for (int i = 0; i < devices.size(); ++i) {
+        const QString path = QString("%1/%2").arg(PK_IIO_PATH, devices.at(i));
+        if (QFileInfo::exists(QString("%1/%2").arg(path, PK_IIO_INPUT)) ||
+            QFileInfo::exists(QString("%1/%2").arg(path, PK_IIO_RAW))) { return path; }
+    }
+    return QString();
+}
+
+bool AmbientLight::isValid()
+{
+    return !input.isEmpty();
+}
+
+bool AmbientLight::isEnabled()
+{
+    return enabled;
+}
+
+double AmbientLight::getLux()
+{
+    double lux = 0.0;
+    readLux(&lux);
+    return lux;
+}
+
+int AmbientLight::getOffset()
+{
+    return userOffset;
+}
+
+bool AmbientLight::readLux(double *lux)
+{
+    QFile file(input);
+    if (!file.open(QIODevice::ReadOnly)) { return false; }
+    bool ok = false;
+    double value = file.readAll().trimmed().toDouble(&ok);
+    if (!ok) { return false; }
+    *lux = qMax((value + offset) * scale, 0.0);
+    return true;
+}
+
+void AmbientLight::sample()
+{
+    double lux = 0.0;
+    if (!readLux(&lux)) {
+        qWarning() << "failed to read ambient light sensor" << input;
+        sampleTimer.start(PK_AMBIENT_INTERVAL_MAX);
+        return;
+    }
+
+    // smooth in log space, that's how we perceive light
+    double level = std::log10(lux + 1.0);
+    double delta = filtered < 0 ? 1.0 : std::fabs(level - filtered);
+    filtered = filtered < 0 ? level : filtered + (level - filtered) * PK_AMBIENT_SMOOTHING;
+
+    // poll fast while the light changes, back off while it's stable
+    int interval = sampleTimer.interval();
+    if (delta > PK_AMBIENT_STABLE) { interval = PK_AMBIENT_INTERVAL_MIN; }
+    else { interval = qMin(interval * 2, PK_AMBIENT_INTERVAL_MAX); }
+    sampleTimer.start(qMax(interval, PK_AMBIENT_INTERVAL_MIN));
+
+    base = qRound(filtered / std::log10(PK_AMBIENT_MAX_LUX + 1.0) * 100.0);
+    int percent = qBound(PK_AMBIENT_MIN_PERCENT, base + userOffset, 100);
+    if (applied >= 0 && qAbs(percent - applied) < PK_AMBIENT_HYSTERESIS) { return; }
+    qDebug() << "ambient light" << lux << "brightness" << percent;
+    applied = percent;
+    emit brightnessRequested(percent);
+}
+
+void AmbientLight::setRunning()
+{
+    if (enabled && !paused && isValid()) {
+        if (sampleTimer.isActive()) { return; }
+        filtered = -1.0;
+        applied = -1;
+        sampleTimer.setInterval(PK_AMBIENT_INTERVAL_MIN);
+        sample();
+    } else { sampleTimer.stop(); }
+}
+
+void AmbientLight::setEnabled(bool enable)
+{
+    if (enabled == enable) { return; }
+    enabled = enable;
+    qDebug() << "ambient light enabled?" << enabled << isValid();
+    setRunning();
+}
+
+void AmbientLight::setPaused(bool pause)
+{
+    if (paused == pause) { return; }
+    paused = pause;
+    setRunning();
+}
+
+void AmbientLight::setOffset(int percent)
+{
+    userOffset = qBound(-100, percent, 100);
+}
+
+// the user adjusted brightness by hand, remember how far off we were
+void AmbientLight::learn(int percent)
+{
+    if (!enabled || paused || base < 0) { return; }
+    setOffset(percent - base);
+    applied = percent;
+    qDebug() << "ambient light offset" << userOffset;
+    emit offsetLearned(userOffset);
+}
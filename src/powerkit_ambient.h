@@ -0,0 +1,60 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef POWERKIT_AMBIENT_H
+#define POWERKIT_AMBIENT_H
+
+#include <QObject>
+#include <QTimer>
+#include <QString>
+
+namespace PowerKit
+{
+    class AmbientLight : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        explicit AmbientLight(QObject *parent = nullptr);
+        static const QString findSensor();
+        bool isValid();
+        bool isEnabled();
+        double getLux();
+        int getOffset();
+
+    private:
+        QString sensor;
+        QString input;
+        double scale;
+        double offset;
+        QTimer sampleTimer;
+        bool enabled;
+        bool paused;
+        double filtered;
+        int applied;
+        int base;
+        int userOffset;
+
+    signals:
+        void brightnessRequested(int percent);
+        void offsetLearned(int percent);
+
+    private slots:
+        bool readLux(double *lux);
+        void sample();
+        void setRunning();
+
+    public slots:
+        void setEnabled(bool enable);
+        void setPaused(bool pause);
+        void setOffset(int percent);
+        void learn(int percent);
+    };
+}
+
+#endif // POWERKIT_AMBIENT_H
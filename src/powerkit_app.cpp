@@ -24,6 +24,9 @@
 #include <QMapIterator>
 
 #define VIRTUAL_MONITOR "VIRTUAL"
+#define INHIBIT_NOTIFY_INTERVAL 600000
+#define PK_CONF_RELOAD_DELAY 250 // msec
+#define PK_AMBIENT_SAVE_DELAY 5000 // msec
 
 #define PK_SCREENSAVER_SERVICE "org.freedesktop.ScreenSaver"
 #define PK_SCREENSAVER_PATH_ROOT "/ScreenSaver"
@@ -44,6 +47,8 @@ App::App(QObject *parent)
     , man(nullptr)
     , pm(nullptr)
     , ss(nullptr)
+    , randr(nullptr)
+    , layout(nullptr)
     , wasLowBattery(false)
     , wasVeryLowBattery(false)
     , lowBatteryValue(POWERKIT_LOW_BATTERY)
@@ -54,8 +59,12 @@ App::App(QObject *parent)
     , criticalAction(POWERKIT_CRITICAL_ACTION)
     , autoSuspendBattery(POWERKIT_AUTO_SLEEP_BATTERY)
     , autoSuspendAC(0)
-    , timer(nullptr)
-    , timeouts(0)
+    , pipeline(nullptr)
+    , idleDimTimeout(POWERKIT_IDLE_DIM_TIMEOUT)
+    , idleDimLevel(POWERKIT_IDLE_DIM_LEVEL)
+    , idleBlankTimeout(POWERKIT_SCREENSAVER_TIMEOUT_BLANK)
+    , idleStandbyTimeout(POWERKIT_IDLE_STANDBY_TIMEOUT)
+    , idleOffTimeout(-1)
     , showNotifications(true)
     , showTray(true)
     , disableLidOnExternalMonitors(false)
@@ -63,7 +72,11 @@ App::App(QObject *parent)
     , autoSuspendACAction(POWERKIT_SUSPEND_AC_ACTION)
     , watcher(nullptr)
     , lidXrandr(false)
+    , displayLayout(false)
     , lidWasClosed(false)
+    , backlights(nullptr)
+    , ambient(nullptr)
+    , backlightAuto(false)
     , hasBacklight(false)
     , backlightOnBattery(false)
     , backlightOnAC(false)
@@ -78,6 +91,9 @@ App::App(QObject *parent)
     , notifyNewInhibitor(true)
     , backlightMouseWheel(true)
     , ignoreKernelResume(false)
+    , confTimer(nullptr)
+    , ambientOffset(0)
+    , ambientTimer(nullptr)
 {
     // setup tray
     tray = new TrayIcon(this);
@@ -131,7 +147,7 @@ App::App(QObject *parent)
     connect(man,
             SIGNAL(Update()),
             this,
-            SLOT(loadSettings()));
+            SLOT(queueReloadSettings()));
     connect(man,
             SIGNAL(Error(QString)),
             this,
@@ -141,12 +157,18 @@ App::App(QObject *parent)
             this,
             SLOT(handleWarning(QString)));
 
+    inhibitClock.start();
+
     // setup org.freedesktop.PowerManagement
     pm = new PowerManagement(this);
     connect(pm,
             SIGNAL(HasInhibitChanged(bool)),
             this,
             SLOT(handleHasInhibitChanged(bool)));
+    connect(pm,
+            SIGNAL(HasInhibitChanged(bool)),
+            man,
+            SLOT(handleHasInhibitChanged(bool)));
     connect(pm,
             SIGNAL(newInhibit(QString,QString,quint32)),
             this,
@@ -183,14 +205,67 @@ App::App(QObject *parent)
             man,
             SLOT(handleDelInhibitScreenSaver(quint32)));
 
-    // setup timer
-    timer = new QTimer(this);
-    timer->setInterval(60000);
-    connect(timer,
+    man->addInhibitors("power", pm->getInhibitors());
+    man->addInhibitors("screensaver", ss->getInhibitors());
+
+    // setup randr
+    randr = new RandR(this);
+    connect(randr,
+            SIGNAL(outputsChanged()),
+            this,
+            SLOT(setInternalMonitor()));
+    setInternalMonitor();
+
+    // setup display layout
+    layout = new Layout(randr, this);
+    connect(man,
+            SIGNAL(isDockedChanged(bool)),
+            layout,
+            SLOT(handleDockedChanged(bool)));
+
+    // follow backlight hotplug
+    backlights = new BacklightSet(this);
+    man->setBacklights(backlights);
+    ambient = new AmbientLight(this);
+    connect(ambient,
+            SIGNAL(brightnessRequested(int)),
+            backlights,
+            SLOT(setPercent(int)));
+    connect(backlights,
+            SIGNAL(stepped(int)),
+            ambient,
+            SLOT(learn(int)));
+    connect(ambient,
+            SIGNAL(offsetLearned(int)),
+            this,
+            SLOT(handleAmbientOffset(int)));
+    // a run of manual steps is saved once
+    ambientTimer = new QTimer(this);
+    ambientTimer->setSingleShot(true);
+    ambientTimer->setInterval(PK_AMBIENT_SAVE_DELAY);
+    connect(ambientTimer,
             SIGNAL(timeout()),
             this,
-            SLOT(timeout()));
-    timer->start();
+            SLOT(saveAmbientOffset()));
+    connect(BacklightRegistry::instance(),
+            SIGNAL(devicesChanged()),
+            this,
+            SLOT(updateBacklight()));
+
+    // setup idle stages
+    pipeline = new IdlePipeline(this);
+    connect(pipeline,
+            SIGNAL(stageChanged(int,int)),
+            this,
+            SLOT(handleIdleStage(int,int)));
+    connect(pipeline,
+            SIGNAL(idleHintChanged(bool)),
+            man,
+            SLOT(handleIdleHintChanged(bool)));
+    connect(ss,
+            SIGNAL(inhibitedChanged(bool)),
+            pipeline,
+            SLOT(setScreenInhibited(bool)));
 
     // check for config
     Settings::getConf();
@@ -209,11 +284,15 @@ App::App(QObject *parent)
     QTimer::singleShot(10000,
                        this,
                        SLOT(checkDevices()));
-    QTimer::singleShot(1000,
-                       this,
-                       SLOT(setInternalMonitor()));
 
-    // setup watcher
+    // setup watcher, bursts of changes are applied once
+    confTimer = new QTimer(this);
+    confTimer->setSingleShot(true);
+    confTimer->setInterval(PK_CONF_RELOAD_DELAY);
+    connect(confTimer,
+            SIGNAL(timeout()),
+            this,
+            SLOT(reloadSettings()));
     watcher = new QFileSystemWatcher(this);
     watcher->addPath(Settings::getDir());
     watcher->addPath(Settings::getConf());
@@ -229,6 +308,7 @@ App::App(QObject *parent)
 
 App::~App()
 {
+    if (ambientTimer->isActive()) { saveAmbientOffset(); }
 }
 
 void App::trayActivated(QSystemTrayIcon::ActivationReason reason)
@@ -307,26 +387,30 @@ void App::handleOpenedLid()
 
 void App::handleOnBattery()
 {
+    updateIdleTimeouts();
+
     if (notifyOnBattery) {
         showMessage(tr("On Battery"),
                     tr("Switched to battery power."));
     }
 
     // brightness
-    if (backlightOnBattery && backlightBatteryValue > 0) {
+    if (backlightOnBattery && backlightBatteryValue > 0 && !ambient->isEnabled()) {
         qDebug() << "set brightness on battery";
         if (backlightBatteryDisableIfLower &&
-            backlightBatteryValue > Backlight::getCurrentBrightness(backlightDevice)) {
+            Backlight::fromPercent(backlightDevice,
+                                   backlightBatteryValue) > backlights->getBrightness()) {
             qDebug() << "brightness is lower than battery value, ignore";
             return;
         }
-        Backlight::setBrightness(backlightDevice,
-                                 backlightBatteryValue);
+        backlights->setPercent(backlightBatteryValue);
     }
 }
 
 void App::handleOnAC()
 {
+    updateIdleTimeouts();
+
     if (notifyOnAC) {
         showMessage(tr("On AC"),
                     tr("Switched to AC power."));
@@ -336,94 +420,93 @@ void App::handleOnAC()
     wasVeryLowBattery = false;
 
     // brightness
-    if (backlightOnAC && backlightACValue > 0) {
+    if (backlightOnAC && backlightACValue > 0 && !ambient->isEnabled()) {
         qDebug() << "set brightness on ac";
         if (backlightACDisableIfHigher &&
-            backlightACValue < Backlight::getCurrentBrightness(backlightDevice)) {
+            Backlight::fromPercent(backlightDevice,
+                                   backlightACValue) < backlights->getBrightness()) {
             qDebug() << "brightness is higher than ac value, ignore";
             return;
         }
-        Backlight::setBrightness(backlightDevice,
-                                 backlightACValue);
+        backlights->setPercent(backlightACValue);
     }
 }
 
+// true if any of keys is in changed
+static bool hasChanged(const QStringList &changed,
+                       const QStringList &keys)
+{
+    for (int i = 0; i < keys.size(); ++i) {
+        if (changed.contains(keys.at(i))) { return true; }
+    }
+    return false;
+}
+
 void App::loadSettings()
 {
-    qDebug() << "(re)load settings...";
+    qDebug() << "load settings...";
+    applySettings(QStringList(), true);
+}
 
-    // set default settings
-    if (Settings::isValid(CONF_SUSPEND_BATTERY_TIMEOUT)) {
-        autoSuspendBattery = Settings::getValue(CONF_SUSPEND_BATTERY_TIMEOUT).toInt();
-    }
-    if (Settings::isValid(CONF_SUSPEND_AC_TIMEOUT)) {
-        autoSuspendAC = Settings::getValue(CONF_SUSPEND_AC_TIMEOUT).toInt();
-    }
-    if (Settings::isValid(CONF_SUSPEND_BATTERY_ACTION)) {
-        autoSuspendBatteryAction = Settings::getValue(CONF_SUSPEND_BATTERY_ACTION).toInt();
-    }
-    if (Settings::isValid(CONF_SUSPEND_AC_ACTION)) {
-        autoSuspendACAction = Settings::getValue(CONF_SUSPEND_AC_ACTION).toInt();
-    }
-    if (Settings::isValid(CONF_CRITICAL_BATTERY_TIMEOUT)) {
-        critBatteryValue = Settings::getValue(CONF_CRITICAL_BATTERY_TIMEOUT).toInt();
-    }
-    if (Settings::isValid(CONF_LID_BATTERY_ACTION)) {
-        lidActionBattery = Settings::getValue(CONF_LID_BATTERY_ACTION).toInt();
-    }
-    if (Settings::isValid(CONF_LID_AC_ACTION)) {
-        lidActionAC = Settings::getValue(CONF_LID_AC_ACTION).toInt();
-    }
-    if (Settings::isValid(CONF_CRITICAL_BATTERY_ACTION)) {
-        criticalAction = Settings::getValue(CONF_CRITICAL_BATTERY_ACTION).toInt();
-    }
-    if (Settings::isValid(CONF_TRAY_NOTIFY)) {
-        showNotifications = Settings::getValue(CONF_TRAY_NOTIFY).toBool();
-    }
-    if (Settings::isValid(CONF_TRAY_SHOW)) {
-        showTray = Settings::getValue(CONF_TRAY_SHOW).toBool();
-    }
-    if (Settings::isValid(CONF_LID_DISABLE_IF_EXTERNAL)) {
-        disableLidOnExternalMonitors = Settings::getValue(CONF_LID_DISABLE_IF_EXTERNAL).toBool();
-    }
-    if (Settings::isValid(CONF_LID_XRANDR)) {
-        lidXrandr = Settings::getValue(CONF_LID_XRANDR).toBool();
-    }
-    if (Settings::isValid(CONF_BACKLIGHT_AC_ENABLE)) {
-        backlightOnAC = Settings::getValue(CONF_BACKLIGHT_AC_ENABLE).toBool();
-    }
-    if (Settings::isValid(CONF_BACKLIGHT_AC)) {
-        backlightACValue = Settings::getValue(CONF_BACKLIGHT_AC).toInt();
-    }
-    if (Settings::isValid(CONF_BACKLIGHT_BATTERY_ENABLE)) {
-        backlightOnBattery = Settings::getValue(CONF_BACKLIGHT_BATTERY_ENABLE).toBool();
-    }
-    if (Settings::isValid(CONF_BACKLIGHT_BATTERY)) {
-        backlightBatteryValue = Settings::getValue(CONF_BACKLIGHT_BATTERY).toInt();
-    }
-    if (Settings::isValid(CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER)) {
-        backlightBatteryDisableIfLower =  Settings::getValue(CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER)
-                                                             .toBool();
-    }
-    if (Settings::isValid(CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER)) {
-        backlightACDisableIfHigher = Settings::getValue(CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER)
-                                                        .toBool();
-    }
-    if (Settings::isValid(CONF_WARN_ON_LOW_BATTERY)) {
-        warnOnLowBattery = Settings::getValue(CONF_WARN_ON_LOW_BATTERY).toBool();
-    }
-    if (Settings::isValid(CONF_WARN_ON_VERYLOW_BATTERY)) {
-        warnOnVeryLowBattery = Settings::getValue(CONF_WARN_ON_VERYLOW_BATTERY).toBool();
-    }
-    if (Settings::isValid(CONF_NOTIFY_ON_BATTERY)) {
-        notifyOnBattery = Settings::getValue(CONF_NOTIFY_ON_BATTERY).toBool();
-    }
-    if (Settings::isValid(CONF_NOTIFY_ON_AC)) {
-        notifyOnAC = Settings::getValue(CONF_NOTIFY_ON_AC).toBool();
-    }
-    if (Settings::isValid(CONF_NOTIFY_NEW_INHIBITOR)) {
-        notifyNewInhibitor = Settings::getValue(CONF_NOTIFY_NEW_INHIBITOR).toBool();
-    }
+void App::queueReloadSettings()
+{
+    confTimer->start();
+}
+
+void App::reloadSettings()
+{
+    const QStringList changed = Settings::reload();
+    if (changed.isEmpty()) { return; }
+    qDebug() << "reload settings..." << changed;
+    applySettings(changed, false);
+}
+
+// values are cheap memory lookups, only re-apply what changed
+void App::applySettings(const QStringList &changed,
+                        bool all)
+{
+    // validated and typed in one pass by Settings
+    const Config &conf = Settings::getConfig();
+    autoSuspendBattery = conf.suspendBatteryTimeout;
+    autoSuspendAC = conf.suspendACTimeout;
+    autoSuspendBatteryAction = conf.suspendBatteryAction;
+    autoSuspendACAction = conf.suspendACAction;
+    idleDimTimeout = conf.idleDimTimeout;
+    idleDimLevel = conf.idleDimLevel;
+    idleBlankTimeout = conf.screensaverBlankTimeout;
+    idleStandbyTimeout = conf.idleStandbyTimeout;
+    idleOffTimeout = conf.idleOffTimeout;
+    critBatteryValue = conf.criticalBattery;
+    lidActionBattery = conf.lidBatteryAction;
+    lidActionAC = conf.lidACAction;
+    criticalAction = conf.criticalAction;
+    showNotifications = conf.trayNotify;
+    showTray = conf.trayShow;
+    disableLidOnExternalMonitors = conf.lidDisableIfExternal;
+    lidXrandr = conf.lidXrandr;
+    displayLayout = conf.displayLayout;
+    if (all || changed.contains(CONF_DISPLAY_LAYOUT)) {
+        layout->setEnabled(displayLayout);
+    }
+    if (all) {
+        updateBacklight();
+        Backlight::migratePresets(backlightDevice);
+    }
+    // presets may have been migrated above
+    backlightOnAC = conf.backlightACEnable;
+    backlightACValue = conf.backlightACPercent;
+    backlightOnBattery = conf.backlightBatteryEnable;
+    backlightBatteryValue = conf.backlightBatteryPercent;
+    backlightBatteryDisableIfLower = conf.backlightBatteryDisableIfLower;
+    backlightACDisableIfHigher = conf.backlightACDisableIfHigher;
+    warnOnLowBattery = conf.warnOnLowBattery;
+    warnOnVeryLowBattery = conf.warnOnVeryLowBattery;
+    notifyOnBattery = conf.notifyOnBattery;
+    notifyOnAC = conf.notifyOnAC;
+    notifyNewInhibitor = conf.notifyNewInhibitor;
+    backlightMouseWheel = conf.backlightMouseWheel;
+    backlightAuto = conf.backlightAuto;
+    ignoreKernelResume = conf.kernelBypass;
     /*if (Settings::isValid(CONF_SUSPEND_WAKEUP_HIBERNATE_BATTERY)) {
         man->SetSuspendWakeAlarmOnBattery(Settings::getValue(CONF_SUSPEND_WAKEUP_HIBERNATE_BATTERY).toInt());
     }
@@ -431,35 +514,54 @@ void App::loadSettings()
         man->SetSuspendWakeAlarmOnAC(Settings::getValue(CONF_SUSPEND_WAKEUP_HIBERNATE_AC).toInt());
     }*/
 
-    if (Settings::isValid(CONF_KERNEL_BYPASS)) {
-        ignoreKernelResume = Settings::getValue(CONF_KERNEL_BYPASS).toBool();
-    } else {
-        ignoreKernelResume = false;
-    }
-
     // verify
+    bool verify = all || hasChanged(changed, QStringList()
+                                    << CONF_KERNEL_BYPASS
+                                    << CONF_CRITICAL_BATTERY_ACTION
+                                    << CONF_LID_BATTERY_ACTION
+                                    << CONF_LID_AC_ACTION
+                                    << CONF_SUSPEND_BATTERY_ACTION
+                                    << CONF_SUSPEND_AC_ACTION);
     /*if (!Common::kernelCanResume(ignoreKernelResume)) {
         qDebug() << "hibernate is not activated in kernel (add resume=...)";
         disableHibernate();
     }*/
-    if (!man->CanHibernate()) {
+    if (verify && !man->CanHibernate()) {
         qWarning() << "hibernate is not supported";
         disableHibernate();
     }
-    if (!man->CanSuspend()) {
+    if (verify && !man->CanSuspend()) {
         qWarning() << "suspend not supported";
         disableSuspend();
     }
 
     // backlight
-    backlightDevice = Backlight::getDevice();
-    hasBacklight = Backlight::canAdjustBrightness(backlightDevice);
-    if (Settings::isValid(CONF_BACKLIGHT_MOUSE_WHEEL)) {
-        backlightMouseWheel = Settings::getValue(CONF_BACKLIGHT_MOUSE_WHEEL).toBool();
+    if (all || hasChanged(changed, QStringList()
+                          << CONF_BACKLIGHT_AUTO
+                          << CONF_BACKLIGHT_AUTO_OFFSET)) {
+        // an edited config wins over a learned offset not yet saved
+        ambientTimer->stop();
+        ambient->setOffset(conf.backlightAutoOffset);
+        ambient->setEnabled(backlightAuto && !backlights->getDevice().isEmpty());
     }
 
     // screensaver
-    ss->Update();
+    if (all || hasChanged(changed, QStringList()
+                          << CONF_SCREENSAVER_LOCK_CMD
+                          << CONF_SCREENSAVER_TIMEOUT_BLANK)) {
+        ss->Update();
+    }
+
+    // idle stages and auto suspend
+    if (all || hasChanged(changed, QStringList()
+                          << CONF_IDLE_DIM_TIMEOUT
+                          << CONF_SCREENSAVER_TIMEOUT_BLANK
+                          << CONF_IDLE_STANDBY_TIMEOUT
+                          << CONF_IDLE_OFF_TIMEOUT
+                          << CONF_SUSPEND_BATTERY_TIMEOUT
+                          << CONF_SUSPEND_AC_TIMEOUT)) {
+        updateIdleTimeouts();
+    }
 }
 
 void App::registerService()
@@ -535,7 +637,7 @@ void App::registerService()
 // dbus session inhibit status handler
 void App::handleHasInhibitChanged(bool has_inhibit)
 {
-    if (has_inhibit) { resetTimer(); }
+    pipeline->setPowerInhibited(has_inhibit);
 }
 
 void App::handleLow(double left)
@@ -662,15 +764,11 @@ void App::updateTrayVisibility()
         showTray) { tray->show(); }
 }
 
-// timeout, check if idle
-// timeouts and xss must be >= user value and service has to be empty before suspend
+// timeout, the idle pipeline reached the suspend stage
+// service has to be empty before suspend
 void App::timeout()
 {
-    updateTrayVisibility();
-
-    int uIdle = ss->GetSessionIdleTime() / 60;
-
-    qDebug() << "timeout?" << timeouts << "idle?" << uIdle << "inhibit?" << pm->HasInhibit() << man->GetInhibitors();
+    qDebug() << "timeout?" << "inhibit?" << pm->HasInhibit() << man->GetInhibitors();
 
     int autoSuspend = 0;
     int autoSuspendAction = suspendNone;
@@ -683,70 +781,119 @@ void App::timeout()
         autoSuspendAction = autoSuspendACAction;
     }
 
-    bool doSuspend = false;
-    if (autoSuspend>0 &&
-        timeouts>=autoSuspend &&
-        uIdle>=autoSuspend &&
-        !pm->HasInhibit()) { doSuspend = true; }
-    if (!doSuspend) { timeouts++; }
-    else {
-        timeouts = 0;
-        qDebug() << "auto suspend activated" << autoSuspendAction;
-        switch (autoSuspendAction) {
-        case suspendSleep:
-            man->Suspend();
-            break;
-        case suspendHibernate:
-            man->Hibernate();
-            break;
-        case suspendShutdown:
-            man->PowerOff();
-            break;
-        case suspendHybrid:
-            man->HybridSleep();
-            break;
-        case suspendSleepHibernate:
-            man->SuspendThenHibernate();
-            break;
-        default:;
-        }
+    if (autoSuspend < 1 ||
+        pm->HasInhibit()) { return; }
+
+    qDebug() << "auto suspend activated" << autoSuspendAction;
+    switch (autoSuspendAction) {
+    case suspendSleep:
+        man->Suspend();
+        break;
+    case suspendHibernate:
+        man->Hibernate();
+        break;
+    case suspendShutdown:
+        man->PowerOff();
+        break;
+    case suspendHybrid:
+        man->HybridSleep();
+        break;
+    case suspendSleepHibernate:
+        man->SuspendThenHibernate();
+        break;
+    default:;
+    }
+}
+
+void App::updateIdleTimeouts()
+{
+    int autoSuspend = man->OnBattery() ? autoSuspendBattery : autoSuspendAC;
+    // displays go off with the blank stage unless configured
+    int offTimeout = idleOffTimeout < 0 ? idleBlankTimeout : idleOffTimeout;
+    qDebug() << "update idle timeouts" << idleDimTimeout << idleBlankTimeout
+             << idleStandbyTimeout << offTimeout << autoSuspend;
+    pipeline->setTimeout(idleDim, backlights->isEmpty() ? 0 : qMax(idleDimTimeout, 0));
+    pipeline->setTimeout(idleBlank, qMax(idleBlankTimeout, 0));
+    pipeline->setTimeout(idleStandby, qMax(idleStandbyTimeout, 0));
+    pipeline->setTimeout(idleOff, qMax(offTimeout, 0));
+    pipeline->setTimeout(idleSuspend, autoSuspend > 0 ? autoSuspend * 60 : 0);
+}
+
+void App::handleIdleStage(int stage, int previous)
+{
+    // don't fight the idle dimming
+    ambient->setPaused(stage != idleActive);
+    switch (stage) {
+    case idleActive:
+        if (previous >= idleStandby) { ss->setDisplaysOff(false); }
+        backlights->restore();
+        break;
+    case idleDim:
+        backlights->dim(idleDimLevel);
+        break;
+    case idleBlank:
+        ss->Blank();
+        break;
+    case idleStandby:
+        ss->setDisplaysStandby();
+        break;
+    case idleOff:
+        ss->setDisplaysOff(true);
+        break;
+    case idleSuspend:
+        timeout();
+        break;
+    default:;
     }
 }
 
-void App::resetTimer()
+void App::updateBacklight()
 {
-    timeouts = 0;
+    backlightDevice = Backlight::getDevice();
+    hasBacklight = Backlight::canAdjustBrightness(backlightDevice);
+    backlights->setDevices(BacklightRegistry::instance()->getPanels(),
+                           BacklightRegistry::instance()->getKeyboards());
+}
+
+void App::handleAmbientOffset(int percent)
+{
+    ambientOffset = percent;
+    ambientTimer->start();
+}
+
+void App::saveAmbientOffset()
+{
+    ambientTimer->stop();
+    if (Settings::getConfig().backlightAutoOffset == ambientOffset) { return; }
+    Settings::setValue(CONF_BACKLIGHT_AUTO_OFFSET, ambientOffset);
 }
 
 void App::setInternalMonitor()
 {
-    internalMonitor = ss->GetInternalDisplay();
+    const QString monitor = randr->getInternalOutput();
+    if (monitor == internalMonitor) { return; }
+    internalMonitor = monitor;
     qDebug() << "internal monitor set to" << internalMonitor;
-    qDebug() << ss->GetDisplays();
 }
 
 bool App::internalMonitorIsConnected()
 {
-    QMapIterator<QString, bool> i(ss->GetDisplays());
-    while (i.hasNext()) {
-        i.next();
-        if (i.key() == internalMonitor) {
-            qDebug() << "internal monitor connected?" << i.key() << i.value();
-            return i.value();
-        }
-    }
-    return false;
+    const auto outputs = randr->getOutputs();
+    if (!outputs.contains(internalMonitor)) { return false; }
+    bool connected = outputs.value(internalMonitor).connected;
+    qDebug() << "internal monitor connected?" << internalMonitor << connected;
+    return connected;
 }
 
 bool App::externalMonitorIsConnected()
 {
-    QMapIterator<QString, bool> i(ss->GetDisplays());
+    QMapIterator<QString, RandR::Output> i(randr->getOutputs());
     while (i.hasNext()) {
         i.next();
         if (i.key()!=internalMonitor &&
             !i.key().startsWith(VIRTUAL_MONITOR)) {
-            qDebug() << "external monitor connected?" << i.key() << i.value();
-            if (i.value()) { return true; }
+            qDebug() << "external monitor connected?" << i.key() << i.value().connected;
+            if (i.value().connected) { return true; }
         }
     }
     return false;
@@ -757,12 +904,10 @@ void App::handleNewInhibitScreenSaver(const QString &application,
                                       quint32 cookie)
 {
     Q_UNUSED(cookie)
-    if (notifyNewInhibitor) {
+    if (notifyNewInhibitor && canNotifyInhibitor(application)) {
         showMessage(tr("New screen inhibitor"),
                     QString("%1: %2").arg(application, reason));
     }
-
-    checkDevices();
 }
 
 void App::handleNewInhibitPowerManagement(const QString &application,
@@ -770,24 +915,30 @@ void App::handleNewInhibitPowerManagement(const QString &application,
                                           quint32 cookie)
 {
     Q_UNUSED(cookie)
-    if (notifyNewInhibitor) {
+    if (notifyNewInhibitor && canNotifyInhibitor(application)) {
         showMessage(tr("New power inhibitor"),
                     QString("%1: %2").arg(application, reason));
     }
-
-    checkDevices();
 }
 
 void App::handleDelInhibitScreenSaver(quint32 cookie)
 {
     Q_UNUSED(cookie)
-    checkDevices();
 }
 
 void App::handleDelInhibitPowerManagement(quint32 cookie)
 {
     Q_UNUSED(cookie)
-    checkDevices();
+}
+
+// don't spam the user with clients that inhibit over and over
+bool App::canNotifyInhibitor(const QString &application)
+{
+    qint64 now = inhibitClock.elapsed();
+    if (notifiedInhibitors.contains(application) &&
+        now - notifiedInhibitors.value(application) < INHIBIT_NOTIFY_INTERVAL) { return false; }
+    notifiedInhibitors[application] = now;
+    return true;
 }
 
 void App::showMessage(const QString &title,
@@ -813,11 +964,16 @@ void App::showMessage(const QString &title,
 void App::handleConfChanged(const QString &file)
 {
     Q_UNUSED(file)
-    loadSettings();
+    // settings are replaced by rename, watch the new file
+    if (!watcher->files().contains(Settings::getConf())) {
+        watcher->addPath(Settings::getConf());
+    }
+    queueReloadSettings();
 }
 
 void App::disableHibernate()
 {
+    Settings::beginTransaction();
     if (criticalAction == criticalHibernate) {
         qWarning() << "reset critical action to shutdown";
         criticalAction = criticalShutdown;
@@ -848,10 +1004,12 @@ void App::disableHibernate()
         Settings::setValue(CONF_SUSPEND_AC_ACTION,
                            autoSuspendACAction);
     }
+    Settings::commitTransaction();
 }
 
 void App::disableSuspend()
 {
+    Settings::beginTransaction();
     if (lidActionBattery == lidSleep) {
         qWarning() << "reset lid battery action to lock";
         lidActionBattery = lidLock;
@@ -876,12 +1034,12 @@ void App::disableSuspend()
         Settings::setValue(CONF_SUSPEND_AC_ACTION,
                            autoSuspendACAction);
     }
+    Settings::commitTransaction();
 }
 
 void App::handlePrepareForSuspend()
 {
     /*qDebug() << "prepare for suspend";
-    resetTimer();
     man->ReleaseSuspendLock();*/
     qDebug() << "do nothing";
 }
@@ -889,18 +1047,16 @@ void App::handlePrepareForSuspend()
 void App::handlePrepareForResume()
 {
     qDebug() << "prepare for resume ...";
-    resetTimer();
+    pipeline->reset();
     ss->setDisplaysOff(false);
 }
 
-// turn off/on monitor using xrandr
+// turn off/on monitor using randr
 void App::switchInternalMonitor(bool toggle)
 {
-    if (!lidXrandr) { return; }
-    qDebug() << "using xrandr to turn on/off internal monitor" << internalMonitor << toggle;
-    QStringList args;
-    args << "--output" << internalMonitor << (toggle ? "--auto" : "--off");
-    QProcess::startDetached("xrandr", args);
+    if (!lidXrandr || internalMonitor.isEmpty()) { return; }
+    qDebug() << "using randr to turn on/off internal monitor" << internalMonitor << toggle;
+    randr->setOutputEnabled(internalMonitor, toggle);
 }
 
 // adjust backlight on wheel event (on systray)
@@ -909,12 +1065,10 @@ void App::handleTrayWheel(TrayIcon::WheelAction action)
     if (!backlightMouseWheel) { return; }
     switch (action) {
     case TrayIcon::WheelUp:
-        Backlight::setBrightness(backlightDevice,
-                                 Backlight::getCurrentBrightness(backlightDevice)+POWERKIT_BACKLIGHT_STEP);
+        backlights->step(POWERKIT_BACKLIGHT_STEP);
         break;
     case TrayIcon::WheelDown:
-        Backlight::setBrightness(backlightDevice,
-                                 Backlight::getCurrentBrightness(backlightDevice)-POWERKIT_BACKLIGHT_STEP);
+        backlights->step(-POWERKIT_BACKLIGHT_STEP);
         break;
     default:;
     }
@@ -14,12 +14,19 @@
 #include <QTimer>
 #include <QProcess>
 #include <QFileSystemWatcher>
+#include <QElapsedTimer>
+#include <QMap>
 #include <QEvent>
 #include <QWheelEvent>
 
 #include "powerkit_powermanagement.h"
 #include "powerkit_screensaver.h"
 #include "powerkit_manager.h"
+#include "powerkit_pipeline.h"
+#include "powerkit_brightness.h"
+#include "powerkit_ambient.h"
+#include "powerkit_randr.h"
+#include "powerkit_layout.h"
 
 namespace PowerKit
 {
@@ -55,6 +62,8 @@ namespace PowerKit
         PowerKit::Manager *man;
         PowerKit::PowerManagement *pm;
         PowerKit::ScreenSaver *ss;
+        PowerKit::RandR *randr;
+        PowerKit::Layout *layout;
         bool wasLowBattery;
         bool wasVeryLowBattery;
         int lowBatteryValue;
@@ -65,8 +74,12 @@ namespace PowerKit
         int criticalAction;
         int autoSuspendBattery;
         int autoSuspendAC;
-        QTimer *timer;
-        int timeouts;
+        IdlePipeline *pipeline;
+        int idleDimTimeout;
+        int idleDimLevel;
+        int idleBlankTimeout;
+        int idleStandbyTimeout;
+        int idleOffTimeout;
         bool showNotifications;
         bool showTray;
         bool disableLidOnExternalMonitors;
@@ -75,8 +88,12 @@ namespace PowerKit
         QString internalMonitor;
         QFileSystemWatcher *watcher;
         bool lidXrandr;
+        bool displayLayout;
         bool lidWasClosed;
         QString backlightDevice;
+        BacklightSet *backlights;
+        AmbientLight *ambient;
+        bool backlightAuto;
         bool hasBacklight;
         bool backlightOnBattery;
         bool backlightOnAC;
@@ -91,6 +108,11 @@ namespace PowerKit
         bool notifyNewInhibitor;
         bool backlightMouseWheel;
         bool ignoreKernelResume;
+        QElapsedTimer inhibitClock;
+        QMap<QString, qint64> notifiedInhibitors;
+        QTimer *confTimer;
+        int ambientOffset;
+        QTimer *ambientTimer;
 
     private slots:
         void trayActivated(QSystemTrayIcon::ActivationReason reason);
@@ -100,6 +122,10 @@ namespace PowerKit
         void handleOnBattery();
         void handleOnAC();
         void loadSettings();
+        void queueReloadSettings();
+        void reloadSettings();
+        void applySettings(const QStringList &changed,
+                           bool all);
         void registerService();
         void handleHasInhibitChanged(bool has_inhibit);
         void handleLow(double left);
@@ -109,7 +135,11 @@ namespace PowerKit
         void updateToolTip();
         void updateTrayVisibility();
         void timeout();
-        void resetTimer();
+        void updateIdleTimeouts();
+        void handleIdleStage(int stage, int previous);
+        void updateBacklight();
+        void handleAmbientOffset(int percent);
+        void saveAmbientOffset();
         void setInternalMonitor();
         bool internalMonitorIsConnected();
         bool externalMonitorIsConnected();
@@ -121,6 +151,7 @@ namespace PowerKit
                                              quint32 cookie);
         void handleDelInhibitScreenSaver(quint32 cookie);
         void handleDelInhibitPowerManagement(quint32 cookie);
+        bool canNotifyInhibitor(const QString &application);
         void showMessage(const QString &title,
                          const QString &msg,
                          bool critical = false);
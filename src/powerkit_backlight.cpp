@@ -8,36 +8,309 @@
 
 #include "powerkit_backlight.h"
 #include "powerkit_common.h"
+#include "powerkit_settings.h"
 
 #include <QFile>
 #include <QDir>
-#include <QDirIterator>
+#include <QMap>
+#include <QCoreApplication>
 #include <QDBusInterface>
+#include <QDBusConnection>
 #include <QDBusMessage>
+#include <QDBusPendingCall>
+#include <QDBusPendingReply>
+#include <QTextStream>
 #include <QDebug>
 
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <unistd.h>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
 #define LOGIND_SESSION "org.freedesktop.login1.Session"
 #define LOGIND_PATH_SESSION "/org/freedesktop/login1/session/self"
+#define PK_BACKLIGHT_PATH "/sys/class/backlight"
+#define PK_BACKLIGHT_SUBSYSTEM "SUBSYSTEM=backlight"
+#define PK_LEDS_PATH "/sys/class/leds"
+#define PK_LEDS_SUBSYSTEM "SUBSYSTEM=leds"
+#define PK_LEDS_KEYBOARD "kbd_backlight"
+#define PK_UEVENT_BUFFER 4096
+#define PK_BACKLIGHT_GAMMA 2.2
 
 using namespace PowerKit;
 
-const QString Backlight::getDevice()
+static const QString readValue(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) { return QString(); }
+    return QString::fromLatin1(file.readAll().trimmed());
+}
+
+// same order as the kernel documents, firmware before platform before raw
+static int rankType(const QString &type)
+{
+    if (type == "firmware") { return 0; }
+    if (type == "platform") { return 1; }
+    if (type == "raw") { return 2; }
+    return 3;
+}
+
+BacklightRegistry *BacklightRegistry::instance()
+{
+    static BacklightRegistry *registry = nullptr;
+    if (!registry) { registry = new BacklightRegistry(qApp); }
+    return registry;
+}
+
+BacklightRegistry::BacklightRegistry(QObject *parent)
+    : QObject(parent)
+    , scanned(false)
+    , ueventSocket(-1)
+    , notifier(nullptr)
+{
+    setupUevents();
+}
+
+BacklightRegistry::~BacklightRegistry()
+{
+    if (ueventSocket >= 0) { ::close(ueventSocket); }
+}
+
+const QStringList BacklightRegistry::findDevices()
+{
+    QMap<QString, QString> ranked;
+    QDir dir(PK_BACKLIGHT_PATH);
+    const QStringList names = dir.entryList(QDir::Dirs | QDir::System | QDir::NoDotAndDotDot,
+                                            QDir::Name);
+    for (int i = 0; i < names.size(); ++i) {
+        const QString path = QString("%1/%2").arg(PK_BACKLIGHT_PATH, names.at(i));
+        int rank = rankType(readValue(QString("%1/type").arg(path)));
+        ranked.insert(QString("%1/%2").arg(rank).arg(names.at(i)), path);
+    }
+    return ranked.values();
+}
+
+const QStringList BacklightRegistry::findKeyboards()
+{
+    QStringList result;
+    QDir dir(PK_LEDS_PATH);
+    const QStringList names = dir.entryList(QStringList() << QString("*%1*").arg(PK_LEDS_KEYBOARD),
+                                            QDir::Dirs | QDir::System | QDir::NoDotAndDotDot,
+                                            QDir::Name);
+    for (int i = 0; i < names.size(); ++i) {
+        result << QString("%1/%2").arg(PK_LEDS_PATH, names.at(i));
+    }
+    return result;
+}
+
+void BacklightRegistry::scan()
 {
-    QString path = "/sys/class/backlight";
-    QDirIterator it(path, QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-        QString foundDir = it.next();
-        if (foundDir.startsWith(QString("%1/radeon").arg(path))) {
-            return foundDir;
-        } else if (foundDir.startsWith(QString("%1/amdgpu").arg(path))) {
-            return foundDir;
-        } else if (foundDir.startsWith(QString("%1/intel").arg(path))) {
-            return foundDir;
-        } else if (foundDir.startsWith(QString("%1/acpi").arg(path))) {
-            return foundDir;
+    if (scanned) { return; }
+    const QStringList devices = findDevices();
+    device = devices.isEmpty() ? QString() : devices.first();
+
+    // firmware and platform interfaces drive every panel, raw ones
+    // are per connector so dual panel systems have one each
+    panels.clear();
+    if (!device.isEmpty()) { panels << device; }
+    if (readValue(QString("%1/type").arg(device)) == "raw") {
+        for (int i = 1; i < devices.size(); ++i) {
+            if (readValue(QString("%1/type").arg(devices.at(i))) == "raw") { panels << devices.at(i); }
         }
     }
-    return QString();
+    keyboards = findKeyboards();
+
+    // without uevents we can't tell when to rescan
+    scanned = ueventSocket >= 0;
+    qDebug() << "backlight devices" << panels << keyboards << devices;
+}
+
+const QString BacklightRegistry::getDevice()
+{
+    scan();
+    return device;
+}
+
+const QStringList BacklightRegistry::getPanels()
+{
+    scan();
+    return panels;
+}
+
+const QStringList BacklightRegistry::getKeyboards()
+{
+    scan();
+    return keyboards;
+}
+
+int BacklightRegistry::getMaxBrightness(const QString &device)
+{
+    if (maxBrightness.contains(device)) { return maxBrightness.value(device); }
+    int result = readValue(QString("%1/max_brightness").arg(device)).toInt();
+    if (result > 0 && ueventSocket >= 0) { maxBrightness[device] = result; }
+    return result;
+}
+
+// percent to hardware value, perceived brightness is roughly a power law
+const QVector<int> BacklightRegistry::getCurve(const QString &device)
+{
+    if (curves.contains(device)) { return curves.value(device); }
+    int max = getMaxBrightness(device);
+    QVector<int> curve(101, 0);
+    if (max < 1) { return curve; }
+    for (int i = 0; i < curve.size(); ++i) {
+        int value = qRound(max * std::pow(i / 100.0, PK_BACKLIGHT_GAMMA));
+        curve[i] = qBound(1, value, max);
+    }
+    if (ueventSocket >= 0) { curves[device] = curve; }
+    return curve;
+}
+
+// hotkeys and the tray wheel end up here, so never block when asked not to
+bool BacklightRegistry::setBrightness(const QString &device,
+                                      int value,
+                                      bool async)
+{
+    if (device.isEmpty()) { return false; }
+    int max = getMaxBrightness(device);
+    // panels never go fully dark, keyboard lights may be switched off
+    int min = device.startsWith(PK_LEDS_PATH) ? 0 : 1;
+    if (max > 0) { value = qBound(min, value, max); }
+
+    // writable (udev rule), no need for a round trip
+    if (Backlight::canAdjustBrightness(device)) {
+        QFile backlight(QString("%1/brightness").arg(device));
+        if (backlight.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            QTextStream out(&backlight);
+            out << QString::number(value);
+            out.flush();
+            backlight.close();
+            if (backlight.error() == QFileDevice::NoError) { return true; }
+        }
+        qWarning() << "failed to write backlight" << device << backlight.errorString();
+    }
+
+    const QString name = device.section("/", -1);
+    // backlight or leds
+    const QString subsystem = device.section("/", -2, -2);
+    QDBusMessage message = createSessionCall("SetBrightness");
+    message << subsystem << name << (quint32)value;
+    if (!async) {
+        QDBusMessage reply = QDBusConnection::systemBus().call(message);
+        return reply.errorMessage().isEmpty();
+    }
+    QDBusPendingCall call = QDBusConnection::systemBus().asyncCall(message);
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(handleBrightnessReply(QDBusPendingCallWatcher*)));
+    return true;
+}
+
+// the manager resolves the real session, use that when available
+void BacklightRegistry::setSession(QDBusInterface *proxy)
+{
+    session = proxy;
+}
+
+// a plain method call needs no proxy, so there is no introspection
+// round trip, the fallback is the caller's own session
+const QDBusMessage BacklightRegistry::createSessionCall(const QString &method)
+{
+    if (session && session->isValid()) {
+        return QDBusMessage::createMethodCall(session->service(),
+                                              session->path(),
+                                              session->interface(),
+                                              method);
+    }
+    return QDBusMessage::createMethodCall(POWERKIT_LOGIND_SERVICE,
+                                          LOGIND_PATH_SESSION,
+                                          LOGIND_SESSION,
+                                          method);
+}
+
+void BacklightRegistry::handleBrightnessReply(QDBusPendingCallWatcher *call)
+{
+    QDBusPendingReply<> reply = *call;
+    if (reply.isError()) { qWarning() << "failed to set brightness" << reply.error().message(); }
+    call->deleteLater();
+}
+
+void BacklightRegistry::setupUevents()
+{
+    ueventSocket = ::socket(AF_NETLINK,
+                            SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                            NETLINK_KOBJECT_UEVENT);
+    if (ueventSocket < 0) {
+        qWarning() << "failed to open uevent socket";
+        return;
+    }
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1; // kernel events
+    if (::bind(ueventSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        qWarning() << "failed to bind uevent socket";
+        ::close(ueventSocket);
+        ueventSocket = -1;
+        return;
+    }
+    notifier = new QSocketNotifier(ueventSocket, QSocketNotifier::Read, this);
+    connect(notifier, SIGNAL(activated(int)),
+            this, SLOT(handleUevents()));
+}
+
+void BacklightRegistry::handleUevents()
+{
+    char buffer[PK_UEVENT_BUFFER];
+    ssize_t len;
+    while ((len = ::recv(ueventSocket, buffer, sizeof(buffer) - 1, 0)) > 0) {
+        buffer[len] = '\0';
+        // action@devpath followed by KEY=VALUE pairs, all nul terminated
+        QString action;
+        QString path;
+        bool backlight = false;
+        bool leds = false;
+        for (ssize_t i = 0; i < len; i += strlen(buffer + i) + 1) {
+            const QString field = QString::fromLatin1(buffer + i);
+            if (i == 0) {
+                action = field.section("@", 0, 0);
+                path = field.section("@", 1);
+            } else if (field == PK_BACKLIGHT_SUBSYSTEM) { backlight = true; }
+            else if (field == PK_LEDS_SUBSYSTEM) { leds = true; }
+        }
+        if (leds && path.contains(PK_LEDS_KEYBOARD) && action != "change") {
+            qDebug() << "keyboard backlight uevent" << action << path;
+            invalidate();
+            emit devicesChanged();
+            continue;
+        }
+        if (!backlight) { continue; }
+        qDebug() << "backlight uevent" << action << path;
+        if (action == "change") {
+            emit brightnessChanged(QString("%1/%2").arg(PK_BACKLIGHT_PATH,
+                                                        path.section("/", -1)));
+        } else {
+            invalidate();
+            emit devicesChanged();
+        }
+    }
+}
+
+void BacklightRegistry::invalidate()
+{
+    scanned = false;
+    device.clear();
+    panels.clear();
+    keyboards.clear();
+    maxBrightness.clear();
+    curves.clear();
+}
+
+const QString Backlight::getDevice()
+{
+    return BacklightRegistry::instance()->getDevice();
 }
 
 bool Backlight::canAdjustBrightness(const QString &device)
@@ -54,13 +327,7 @@ bool Backlight::canAdjustBrightness()
 
 int Backlight::getMaxBrightness(const QString &device)
 {
-    int result = 0;
-    QFile backlight(QString("%1/max_brightness").arg(device));
-    if (backlight.open(QIODevice::ReadOnly)) {
-        result = backlight.readAll().trimmed().toInt();
-        backlight.close();
-    }
-    return result;
+    return BacklightRegistry::instance()->getMaxBrightness(device);
 }
 
 int Backlight::getMaxBrightness()
@@ -84,6 +351,37 @@ int Backlight::getCurrentBrightness()
     return getCurrentBrightness(getDevice());
 }
 
+int Backlight::toPercent(const QString &device, int value)
+{
+    const QVector<int> curve = BacklightRegistry::instance()->getCurve(device);
+    // highest percent that doesn't exceed value
+    int percent = std::upper_bound(curve.constBegin(), curve.constEnd(), value) - curve.constBegin();
+    return qBound(0, percent - 1, 100);
+}
+
+int Backlight::fromPercent(const QString &device, int percent)
+{
+    return BacklightRegistry::instance()->getCurve(device).at(qBound(0, percent, 100));
+}
+
+// presets used to be stored as hardware values
+void Backlight::migratePresets(const QString &device)
+{
+    if (getMaxBrightness(device) < 1) { return; }
+    Settings::beginTransaction();
+    if (!Settings::isValid(CONF_BACKLIGHT_BATTERY_PERCENT) &&
+        Settings::isValid(CONF_BACKLIGHT_BATTERY)) {
+        Settings::setValue(CONF_BACKLIGHT_BATTERY_PERCENT,
+                           toPercent(device, Settings::getValue(CONF_BACKLIGHT_BATTERY).toInt()));
+    }
+    if (!Settings::isValid(CONF_BACKLIGHT_AC_PERCENT) &&
+        Settings::isValid(CONF_BACKLIGHT_AC)) {
+        Settings::setValue(CONF_BACKLIGHT_AC_PERCENT,
+                           toPercent(device, Settings::getValue(CONF_BACKLIGHT_AC).toInt()));
+    }
+    Settings::commitTransaction();
+}
+
 bool Backlight::setCurrentBrightness(const QString &device, int value)
 {
     if (!canAdjustBrightness(device)) { return false; }
@@ -104,21 +402,14 @@ bool Backlight::setCurrentBrightness(int value)
 }
 
 bool Backlight::setBrightness(const QString &device,
-                              int value)
+                              int value,
+                              bool async)
 {
-    QDBusInterface iface(POWERKIT_LOGIND_SERVICE,
-                         LOGIND_PATH_SESSION,
-                         LOGIND_SESSION,
-                         QDBusConnection::systemBus());
-    if (!iface.isValid()) { return false; }
-    QDBusMessage reply = iface.call("SetBrightness",
-                                    "backlight",
-                                    device.split("/").takeLast(),
-                                    (quint32)value);
-    return reply.errorMessage().isEmpty();
+    return BacklightRegistry::instance()->setBrightness(device, value, async);
 }
 
-bool Backlight::setBrightness(int value)
+bool Backlight::setBrightness(int value,
+                              bool async)
 {
-    return setBrightness(getDevice(), value);
+    return setBrightness(getDevice(), value, async);
 }
@@ -9,10 +9,65 @@
 #ifndef POWERKIT_BACKLIGHT_H
 #define POWERKIT_BACKLIGHT_H
 
+#include <QObject>
 #include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QSocketNotifier>
+#include <QPointer>
+#include <QDBusInterface>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
 
 namespace PowerKit
 {
+    class BacklightRegistry : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        static BacklightRegistry *instance();
+        static const QStringList findDevices();
+        static const QStringList findKeyboards();
+        const QString getDevice();
+        const QStringList getPanels();
+        const QStringList getKeyboards();
+        int getMaxBrightness(const QString &device);
+        const QVector<int> getCurve(const QString &device);
+        bool setBrightness(const QString &device,
+                           int value,
+                           bool async);
+        void setSession(QDBusInterface *proxy);
+
+    private:
+        explicit BacklightRegistry(QObject *parent = nullptr);
+        ~BacklightRegistry();
+        bool scanned;
+        QString device;
+        QStringList panels;
+        QStringList keyboards;
+        QHash<QString, int> maxBrightness;
+        QHash<QString, QVector<int> > curves;
+        int ueventSocket;
+        QSocketNotifier *notifier;
+        QPointer<QDBusInterface> session;
+        const QDBusMessage createSessionCall(const QString &method);
+
+    signals:
+        void devicesChanged();
+        void brightnessChanged(const QString &device);
+
+    private slots:
+        void scan();
+        void setupUevents();
+        void handleUevents();
+        void handleBrightnessReply(QDBusPendingCallWatcher *call);
+
+    public slots:
+        void invalidate();
+    };
+
     class Backlight
     {
     public:
@@ -23,10 +78,16 @@ namespace PowerKit
         static int getMaxBrightness();
         static int getCurrentBrightness(const QString &device);
         static int getCurrentBrightness();
+        static int toPercent(const QString &device, int value);
+        static int fromPercent(const QString &device, int percent);
+        static void migratePresets(const QString &device);
         static bool setCurrentBrightness(const QString &device, int value); // deprecated
         static bool setCurrentBrightness(int value); // deprecated
-        static bool setBrightness(const QString &device, int value);
-        static bool setBrightness(int value);
+        static bool setBrightness(const QString &device,
+                                  int value,
+                                  bool async = true);
+        static bool setBrightness(int value,
+                                  bool async = true);
     };
 }
 
@@ -0,0 +1,225 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "powerkit_brightness.h"
+#include "powerkit_backlight.h"
+
+#include <QDebug>
+
+#define PK_BRIGHTNESS_FRAME 16 // msec
+#define PK_BRIGHTNESS_DURATION 200 // msec
+
+using namespace PowerKit;
+
+BrightnessAnimator::BrightnessAnimator(QObject *parent)
+    : QObject(parent)
+    , start(0)
+    , current(0)
+    , target(0)
+{
+    // at most one write per frame, whatever the input rate
+    frameTimer.setInterval(PK_BRIGHTNESS_FRAME);
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    connect(&frameTimer, SIGNAL(timeout()),
+            this, SLOT(frame()));
+}
+
+const QString BrightnessAnimator::getDevice()
+{
+    return device;
+}
+
+// where we are heading, the hardware may not be there yet
+int BrightnessAnimator::getBrightness()
+{
+    if (isActive()) { return target; }
+    return Backlight::getCurrentBrightness(device);
+}
+
+bool BrightnessAnimator::isActive()
+{
+    return frameTimer.isActive();
+}
+
+void BrightnessAnimator::frame()
+{
+    qint64 elapsed = clock.elapsed();
+    int value = target;
+    if (elapsed < PK_BRIGHTNESS_DURATION) {
+        // ease out, big jumps first
+        double t = (double)elapsed / PK_BRIGHTNESS_DURATION;
+        t = 1.0 - (1.0 - t) * (1.0 - t);
+        value = start + qRound((target - start) * t);
+    }
+    if (value != current) {
+        current = value;
+        Backlight::setBrightness(device, current);
+    }
+    if (current == target) {
+        frameTimer.stop();
+        emit brightnessChanged(current);
+    }
+}
+
+void BrightnessAnimator::setDevice(const QString &device)
+{
+    if (this->device == device) { return; }
+    stop();
+    this->device = device;
+}
+
+void BrightnessAnimator::setBrightness(int value)
+{
+    if (device.isEmpty()) { return; }
+    int max = Backlight::getMaxBrightness(device);
+    if (max > 0) { value = qBound(1, value, max); }
+    if (!isActive()) {
+        current = Backlight::getCurrentBrightness(device);
+        if (value == current) { return; }
+    } else if (value == target) { return; }
+
+    // retarget from wherever we are, intermediate targets are never written
+    start = current;
+    target = value;
+    clock.start();
+    if (!isActive()) {
+        frameTimer.start();
+        frame();
+    }
+}
+
+void BrightnessAnimator::setPercent(int percent)
+{
+    if (device.isEmpty()) { return; }
+    setBrightness(Backlight::fromPercent(device, percent));
+}
+
+// delta is in percent, always move at least one hardware step
+void BrightnessAnimator::step(int delta)
+{
+    if (device.isEmpty() || delta == 0) { return; }
+    int value = getBrightness();
+    int next = value;
+    int percent = Backlight::toPercent(device, value);
+    while (next == value) {
+        // near either end the bound itself is the last candidate
+        int candidate = qBound(0, percent + delta, 100);
+        if (candidate == percent) { break; }
+        percent = candidate;
+        next = Backlight::fromPercent(device, percent);
+    }
+    setBrightness(next);
+}
+
+void BrightnessAnimator::stop()
+{
+    if (!isActive()) { return; }
+    frameTimer.stop();
+    target = current;
+    emit brightnessChanged(current);
+}
+
+BacklightSet::BacklightSet(QObject *parent)
+    : QObject(parent)
+{
+}
+
+// the first panel leads, the rest follow on the percent scale
+const QString BacklightSet::getDevice()
+{
+    if (panels.isEmpty()) { return QString(); }
+    return panels.first()->getDevice();
+}
+
+int BacklightSet::getBrightness()
+{
+    if (panels.isEmpty()) { return 0; }
+    return panels.first()->getBrightness();
+}
+
+bool BacklightSet::isEmpty()
+{
+    return panels.isEmpty() && keyboards.isEmpty();
+}
+
+bool BacklightSet::isDimmed()
+{
+    return !saved.isEmpty();
+}
+
+void BacklightSet::setDevices(const QStringList &panelDevices,
+                              const QStringList &keyboardDevices)
+{
+    QStringList current;
+    for (int i = 0; i < panels.size(); ++i) { current << panels.at(i)->getDevice(); }
+    if (current == panelDevices && keyboards == keyboardDevices) { return; }
+    qDebug() << "backlight set" << panelDevices << keyboardDevices;
+
+    qDeleteAll(panels);
+    panels.clear();
+    for (int i = 0; i < panelDevices.size(); ++i) {
+        BrightnessAnimator *animator = new BrightnessAnimator(this);
+        animator->setDevice(panelDevices.at(i));
+        panels << animator;
+    }
+    keyboards = keyboardDevices;
+    saved.clear();
+}
+
+void BacklightSet::setPercent(int percent)
+{
+    for (int i = 0; i < panels.size(); ++i) { panels.at(i)->setPercent(percent); }
+}
+
+void BacklightSet::step(int delta)
+{
+    if (panels.isEmpty()) { return; }
+    BrightnessAnimator *lead = panels.first();
+    lead->step(delta);
+    int percent = Backlight::toPercent(lead->getDevice(), lead->getBrightness());
+    for (int i = 1; i < panels.size(); ++i) { panels.at(i)->setPercent(percent); }
+    emit stepped(percent);
+}
+
+// dim panels to percent of their current value and switch off keyboard lights
+void BacklightSet::dim(int percent)
+{
+    if (isDimmed()) { return; }
+    for (int i = 0; i < panels.size(); ++i) {
+        BrightnessAnimator *animator = panels.at(i);
+        const QString device = animator->getDevice();
+        int current = animator->getBrightness();
+        // on the perceptual scale, like presets and steps
+        int dimmed = Backlight::fromPercent(device,
+                                            Backlight::toPercent(device, current) * percent / 100);
+        if (dimmed >= current) { continue; }
+        saved[device] = current;
+        animator->setBrightness(dimmed);
+    }
+    for (int i = 0; i < keyboards.size(); ++i) {
+        int current = Backlight::getCurrentBrightness(keyboards.at(i));
+        if (current < 1) { continue; }
+        saved[keyboards.at(i)] = current;
+        Backlight::setBrightness(keyboards.at(i), 0);
+    }
+}
+
+void BacklightSet::restore()
+{
+    if (!isDimmed()) { return; }
+    for (int i = 0; i < panels.size(); ++i) {
+        const QString device = panels.at(i)->getDevice();
+        if (saved.contains(device)) { panels.at(i)->setBrightness(saved.value(device)); }
+    }
+    for (int i = 0; i < keyboards.size(); ++i) {
+        if (saved.contains(keyboards.at(i))) {
+            Backlight::setBrightness(keyboards.at(i), saved.value(keyboards.at(i)));
+        }
+    }
+    saved.clear();
+}
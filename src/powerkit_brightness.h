@@ -0,0 +1,83 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef POWERKIT_BRIGHTNESS_H
+#define POWERKIT_BRIGHTNESS_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QMap>
+
+namespace PowerKit
+{
+    class BrightnessAnimator : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        explicit BrightnessAnimator(QObject *parent = nullptr);
+        const QString getDevice();
+        int getBrightness();
+        bool isActive();
+
+    private:
+        QString device;
+        QTimer frameTimer;
+        QElapsedTimer clock;
+        int start;
+        int current;
+        int target;
+
+    signals:
+        void brightnessChanged(int value);
+
+    private slots:
+        void frame();
+
+    public slots:
+        void setDevice(const QString &device);
+        void setBrightness(int value);
+        void setPercent(int percent);
+        void step(int delta);
+        void stop();
+    };
+
+    class BacklightSet : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        explicit BacklightSet(QObject *parent = nullptr);
+        const QString getDevice();
+        int getBrightness();
+        bool isEmpty();
+        bool isDimmed();
+
+    private:
+        QList<BrightnessAnimator*> panels;
+        QStringList keyboards;
+        QMap<QString, int> saved;
+
+    signals:
+        void stepped(int percent);
+
+    public slots:
+        void setDevices(const QStringList &panelDevices,
+                        const QStringList &keyboardDevices);
+        void setPercent(int percent);
+        void step(int delta);
+        void dim(int percent);
+        void restore();
+    };
+}
+
+#endif // POWERKIT_BRIGHTNESS_H
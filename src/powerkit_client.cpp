@@ -139,6 +139,24 @@ bool Client::lockScreen(QDBusInterface *iface)
     return reply.errorMessage().isEmpty();
 }
 
+bool Client::brightnessUp(QDBusInterface *iface)
+{
+    if (!iface) { return false; }
+    if (!iface->isValid()) { return false; }
+    QDBusMessage reply = iface->call("BrightnessUp");
+    if (!reply.errorMessage().isEmpty()) { return false; }
+    return reply.arguments().size() > 0 && reply.arguments().first().toBool();
+}
+
+bool Client::brightnessDown(QDBusInterface *iface)
+{
+    if (!iface) { return false; }
+    if (!iface->isValid()) { return false; }
+    QDBusMessage reply = iface->call("BrightnessDown");
+    if (!reply.errorMessage().isEmpty()) { return false; }
+    return reply.arguments().size() > 0 && reply.arguments().first().toBool();
+}
+
 bool Client::hibernate(QDBusInterface *iface)
 {
     if (!iface) { return false; }
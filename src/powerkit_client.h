@@ -27,6 +27,8 @@ namespace PowerKit
         static bool canPowerOff(QDBusInterface *iface);
         static bool lidIsPresent(QDBusInterface *iface);
         static bool lockScreen(QDBusInterface *iface);
+        static bool brightnessUp(QDBusInterface *iface);
+        static bool brightnessDown(QDBusInterface *iface);
         static bool hibernate(QDBusInterface *iface);
         static bool suspend(QDBusInterface *iface);
         static bool suspendThenHibernate(QDBusInterface *iface);
@@ -49,6 +49,16 @@ namespace PowerKit
         criticalShutdown,
         criticalSuspend
     };
+
+    enum idleStage
+    {
+        idleActive,
+        idleDim,
+        idleBlank,
+        idleStandby,
+        idleOff,
+        idleSuspend
+    };
 }
 
 #define POWERKIT_LID_BATTERY_ACTION PowerKit::lidSleep
@@ -56,7 +66,7 @@ namespace PowerKit
 #define POWERKIT_CRITICAL_ACTION PowerKit::criticalNone
 #define POWERKIT_SUSPEND_BATTERY_ACTION PowerKit::suspendSleep
 #define POWERKIT_SUSPEND_AC_ACTION PowerKit::suspendNone
-#define POWERKIT_BACKLIGHT_STEP 10 // +/-
+#define POWERKIT_BACKLIGHT_STEP 5 // +/- %
 #define POWERKIT_LOW_BATTERY 5 // % over critical
 #define POWERKIT_CRITICAL_BATTERY 10 // %
 #define POWERKIT_AUTO_SLEEP_BATTERY 15 // min
@@ -70,5 +80,8 @@ namespace PowerKit
 #define POWERKIT_DBUS_PROPERTIES "org.freedesktop.DBus.Properties"
 #define POWERKIT_SCREENSAVER_LOCK_CMD "xsecurelock"
 #define POWERKIT_SCREENSAVER_TIMEOUT_BLANK 300
+#define POWERKIT_IDLE_DIM_TIMEOUT 0 // sec, disabled
+#define POWERKIT_IDLE_DIM_LEVEL 30 // %
+#define POWERKIT_IDLE_STANDBY_TIMEOUT 0 // sec, disabled
 
 #endif // POWERKIT_COMMON_H
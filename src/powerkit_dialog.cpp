@@ -238,6 +238,7 @@ void Dialog::setupWidgets()
     backlightSliderBattery->setMinimum(1);
     backlightSliderBattery->setMaximum(1);
     backlightSliderBattery->setValue(0);
+    backlightSliderBattery->setTracking(false); // save on release
 
     backlightBatteryCheck = new QCheckBox(this);
     backlightBatteryCheck->setCheckable(true);
@@ -356,6 +357,7 @@ void Dialog::setupWidgets()
     backlightSliderAC->setMinimum(1);
     backlightSliderAC->setMaximum(1);
     backlightSliderAC->setValue(0);
+    backlightSliderAC->setTracking(false); // save on release
 
     backlightACCheck = new QCheckBox(this);
     backlightACCheck->setCheckable(true);
@@ -729,8 +731,10 @@ void Dialog::loadSettings()
     backlightSliderAC->setEnabled(true);
     backlightSliderBattery->setEnabled(true);
 
+    // presets are a percent of the perceptual scale
+    Backlight::migratePresets(backlightDevice);
     int backlightMin = 1;
-    int backlightMax = Backlight::getMaxBrightness(backlightDevice);
+    int backlightMax = 100;
 
     backlightSliderBattery->setMinimum(backlightMin);
     backlightSliderBattery->setMaximum(backlightMax);
@@ -743,12 +747,12 @@ void Dialog::loadSettings()
                                       .toBool());
     backlightACCheck->setChecked(Settings::getValue(CONF_BACKLIGHT_AC_ENABLE)
                                  .toBool());
-    if (Settings::isValid(CONF_BACKLIGHT_BATTERY)) {
-        backlightSliderBattery->setValue(Settings::getValue(CONF_BACKLIGHT_BATTERY)
+    if (Settings::isValid(CONF_BACKLIGHT_BATTERY_PERCENT)) {
+        backlightSliderBattery->setValue(Settings::getValue(CONF_BACKLIGHT_BATTERY_PERCENT)
                                          .toInt());
     }
-    if (Settings::isValid(CONF_BACKLIGHT_AC)) {
-        backlightSliderAC->setValue(Settings::getValue(CONF_BACKLIGHT_AC)
+    if (Settings::isValid(CONF_BACKLIGHT_AC_PERCENT)) {
+        backlightSliderAC->setValue(Settings::getValue(CONF_BACKLIGHT_AC_PERCENT)
                                     .toInt());
     }
     if (Settings::isValid(CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER)) {
@@ -804,9 +808,9 @@ void Dialog::saveSettings()
                        backlightBatteryCheck->isChecked());
     Settings::setValue(CONF_BACKLIGHT_AC_ENABLE,
                        backlightACCheck->isChecked());
-    Settings::setValue(CONF_BACKLIGHT_BATTERY,
+    Settings::setValue(CONF_BACKLIGHT_BATTERY_PERCENT,
                        backlightSliderBattery->value());
-    Settings::setValue(CONF_BACKLIGHT_AC,
+    Settings::setValue(CONF_BACKLIGHT_AC_PERCENT,
                        backlightSliderAC->value());
     Settings::setValue(CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER,
                        backlightBatteryLowerCheck->isChecked());
@@ -1065,12 +1069,12 @@ void Dialog::handleBacklightACCheck(bool triggered)
 
 void Dialog::handleBacklightBatterySlider(int value)
 {
-    Settings::setValue(CONF_BACKLIGHT_BATTERY, value);
+    Settings::setValue(CONF_BACKLIGHT_BATTERY_PERCENT, value);
 }
 
 void Dialog::handleBacklightACSlider(int value)
 {
-    Settings::setValue(CONF_BACKLIGHT_AC, value);
+    Settings::setValue(CONF_BACKLIGHT_AC_PERCENT, value);
 }
 
 void Dialog::hibernateWarn()
@@ -0,0 +1,263 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "powerkit_idle.h"
+#include "powerkit_x11.h"
+
+#include <QMapIterator>
+#include <QByteArray>
+#include <QDebug>
+
+#include <climits>
+
+#include <X11/Xlib.h>
+#include <X11/extensions/sync.h>
+#include <X11/extensions/scrnsaver.h>
+
+#define PK_IDLE_COUNTER "IDLETIME"
+#define PK_IDLE_FALLBACK_POLL 10000
+
+using namespace PowerKit;
+
+static qint64 syncValueToInt(const XSyncValue &value)
+{
+    return ((qint64)XSyncValueHigh32(value) << 32) | XSyncValueLow32(value);
+}
+
+IdleMonitor::IdleMonitor(QObject *parent)
+    : QObject(parent)
+    , syncEventBase(0)
+    , idleCounter(0)
+    , resetAlarm(0)
+    , lastId(0)
+{
+    fallback.setInterval(PK_IDLE_FALLBACK_POLL);
+    connect(&fallback, SIGNAL(timeout()),
+            this, SLOT(poll()));
+    connect(X11::instance(), SIGNAL(connected()),
+            this, SLOT(setup()));
+    connect(X11::instance(), SIGNAL(disconnected()),
+            this, SLOT(clear()));
+    connect(X11::instance(), SIGNAL(eventReceived(_XEvent*)),
+            this, SLOT(handleEvent(_XEvent*)));
+    setup();
+}
+
+IdleMonitor::~IdleMonitor()
+{
+    removeAllTimeouts();
+    Display *dpy = X11::instance()->display();
+    if (dpy && resetAlarm) {
+        XSyncDestroyAlarm(dpy, resetAlarm);
+        X11::instance()->flush();
+    }
+}
+
+bool IdleMonitor::isValid()
+{
+    return idleCounter != 0;
+}
+
+int IdleMonitor::addTimeout(quint32 msec)
+{
+    int id = ++lastId;
+    timeouts[id] = msec;
+    reached[id] = false;
+    if (isValid()) {
+        alarms[id] = setAlarm(0, msec, true);
+        X11::instance()->flush();
+    } else if (!fallback.isActive()) { fallback.start(); }
+    qDebug() << "idle timeout added" << id << msec;
+    return id;
+}
+
+void IdleMonitor::removeTimeout(int id)
+{
+    if (!timeouts.contains(id)) { return; }
+    timeouts.remove(id);
+    reached.remove(id);
+    unsigned long alarm = alarms.take(id);
+    Display *dpy = X11::instance()->display();
+    if (dpy && alarm) {
+        XSyncDestroyAlarm(dpy, alarm);
+        X11::instance()->flush();
+    }
+    if (timeouts.isEmpty()) { fallback.stop(); }
+}
+
+void IdleMonitor::removeAllTimeouts()
+{
+    const auto ids = timeouts.keys();
+    for (int i = 0; i < ids.size(); ++i) { removeTimeout(ids.at(i)); }
+}
+
+quint32 IdleMonitor::getIdleTime()
+{
+    quint32 idle = 0;
+    Display *dpy = X11::instance()->display();
+    if (!dpy) { return idle; }
+    if (isValid()) {
+        XSyncValue value;
+        if (XSyncQueryCounter(dpy, idleCounter, &value)) {
+            idle = (quint32)qMin(syncValueToInt(value), (qint64)UINT_MAX);
+        }
+    } else {
+        XScreenSaverInfo *info = XScreenSaverAllocInfo();
+        if (info) {
+            if (XScreenSaverQueryInfo(dpy, DefaultRootWindow(dpy), info)) { idle = info->idle; }
+            XFree(info);
+        }
+    }
+    X11::instance()->flush();
+    return idle;
+}
+
+void IdleMonitor::setup()
+{
+    Display *dpy = X11::instance()->display();
+    if (!dpy) { return; }
+
+    idleCounter = 0;
+    resetAlarm = 0;
+    alarms.clear();
+
+    int syncErrorBase;
+    int major, minor;
+    if (!XSyncQueryExtension(dpy, &syncEventBase, &syncErrorBase) ||
+        !XSyncInitialize(dpy, &major, &minor)) {
+        qWarning() << "XSync extension not available, fallback to idle polling";
+    } else {
+        int count = 0;
+        XSyncSystemCounter *counters = XSyncListSystemCounters(dpy, &count);
+        for (int i = 0; i < count; ++i) {
+            if (qstrcmp(counters[i].name, PK_IDLE_COUNTER) == 0) {
+                idleCounter = counters[i].counter;
+                break;
+            }
+        }
+        if (counters) { XSyncFreeSystemCounterList(counters); }
+        if (!idleCounter) {
+            qWarning() << "XSync has no IDLETIME counter, fallback to idle polling";
+        }
+    }
+
+    if (isValid()) {
+        fallback.stop();
+        QMapIterator<int, quint32> i(timeouts);
+        while (i.hasNext()) {
+            i.next();
+            alarms[i.key()] = setAlarm(0, i.value(), true);
+        }
+        X11::instance()->flush();
+    } else if (!timeouts.isEmpty()) { fallback.start(); }
+}
+
+void IdleMonitor::clear()
+{
+    // server side resources went away with the connection
+    idleCounter = 0;
+    resetAlarm = 0;
+    alarms.clear();
+}
+
+void IdleMonitor::handleEvent(_XEvent *event)
+{
+    if (!isValid() ||
+        event->type != syncEventBase + XSyncAlarmNotify) { return; }
+    XSyncAlarmNotifyEvent *alarmEvent = reinterpret_cast<XSyncAlarmNotifyEvent*>(event);
+    if (alarmEvent->state == XSyncAlarmDestroyed) { return; }
+
+    if (alarmEvent->alarm == resetAlarm) {
+        qDebug() << "resuming from idle";
+        armAlarms();
+        emit resumingFromIdle();
+        return;
+    }
+
+    QMapIterator<int, unsigned long> i(alarms);
+    while (i.hasNext()) {
+        i.next();
+        if (i.value() != alarmEvent->alarm) { continue; }
+        // wake up again on the first input event
+        qint64 idle = syncValueToInt(alarmEvent->counter_value);
+        resetAlarm = setAlarm(resetAlarm, idle > 0 ? idle - 1 : 0, false);
+        X11::instance()->flush();
+        qDebug() << "idle timeout reached" << i.key() << timeouts.value(i.key());
+        emit timeoutReached(i.key(), timeouts.value(i.key()));
+        return;
+    }
+}
+
+unsigned long IdleMonitor::setAlarm(unsigned long alarm,
+                                    qint64 value,
+                                    bool positive)
+{
+    Display *dpy = X11::instance()->display();
+    if (!dpy || !isValid()) { return 0; }
+
+    XSyncAlarmAttributes attr;
+    XSyncValue delta;
+    XSyncIntToValue(&delta, 0);
+    attr.trigger.counter = idleCounter;
+    attr.trigger.value_type = XSyncAbsolute;
+    attr.trigger.test_type = positive ? XSyncPositiveComparison : XSyncNegativeComparison;
+    XSyncIntsToValue(&attr.trigger.wait_value,
+                     (unsigned int)(value & 0xffffffff),
+                     (int)(value >> 32));
+    attr.delta = delta;
+    attr.events = True;
+
+    unsigned long flags = XSyncCACounter |
+                          XSyncCAValueType |
+                          XSyncCATestType |
+                          XSyncCAValue |
+                          XSyncCADelta |
+                          XSyncCAEvents;
+    if (alarm) {
+        XSyncChangeAlarm(dpy, alarm, flags, &attr);
+        return alarm;
+    }
+    return XSyncCreateAlarm(dpy, flags, &attr);
+}
+
+void IdleMonitor::armAlarms()
+{
+    // comparison alarms go inactive once triggered, re-arm them
+    QMapIterator<int, quint32> i(timeouts);
+    while (i.hasNext()) {
+        i.next();
+        alarms[i.key()] = setAlarm(alarms.value(i.key()), i.value(), true);
+    }
+    X11::instance()->flush();
+}
+
+void IdleMonitor::poll()
+{
+    quint32 idle = getIdleTime();
+    bool wasIdle = false;
+    QMapIterator<int, quint32> i(timeouts);
+    while (i.hasNext()) {
+        i.next();
+        if (reached.value(i.key())) { wasIdle = true; }
+    }
+    if (wasIdle && idle < PK_IDLE_FALLBACK_POLL) {
+        QMapIterator<int, bool> r(reached);
+        while (r.hasNext()) {
+            r.next();
+            reached[r.key()] = false;
+        }
+        emit resumingFromIdle();
+    }
+    i.toFront();
+    while (i.hasNext()) {
+        i.next();
+        if (idle < i.value() || reached.value(i.key())) { continue; }
+        reached[i.key()] = true;
+        emit timeoutReached(i.key(), i.value());
+    }
+}
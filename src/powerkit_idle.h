@@ -0,0 +1,59 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef POWERKIT_IDLE_H
+#define POWERKIT_IDLE_H
+
+#include <QObject>
+#include <QTimer>
+#include <QMap>
+
+union _XEvent;
+
+namespace PowerKit
+{
+    class IdleMonitor : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        explicit IdleMonitor(QObject *parent = nullptr);
+        ~IdleMonitor();
+        bool isValid();
+        int addTimeout(quint32 msec);
+        void removeTimeout(int id);
+        void removeAllTimeouts();
+        quint32 getIdleTime();
+
+    private:
+        int syncEventBase;
+        unsigned long idleCounter;
+        unsigned long resetAlarm;
+        QMap<int, quint32> timeouts;
+        QMap<int, unsigned long> alarms;
+        QMap<int, bool> reached;
+        int lastId;
+        QTimer fallback;
+
+    signals:
+        void timeoutReached(int id, quint32 msec);
+        void resumingFromIdle();
+
+    private slots:
+        void setup();
+        void clear();
+        void handleEvent(_XEvent *event);
+        unsigned long setAlarm(unsigned long alarm,
+                               qint64 value,
+                               bool positive);
+        void armAlarms();
+        void poll();
+    };
+}
+
+#endif // POWERKIT_IDLE_H
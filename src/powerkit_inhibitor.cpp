@@ -0,0 +1,218 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "powerkit_inhibitor.h"
+
+#include <QHashIterator>
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusReply>
+#include <QDateTime>
+#include <QRandomGenerator>
+#include <QDebug>
+
+#define PK_INHIBITOR_RELEASE_DELAY 2000
+
+using namespace PowerKit;
+
+InhibitorRegistry::InhibitorRegistry(qint64 maxInhibit,
+                                     QObject *parent)
+    : QObject(parent)
+    , maxInhibit(maxInhibit)
+    , watcher(nullptr)
+    , inhibited(false)
+{
+    clock.start();
+    expireTimer.setSingleShot(true);
+    connect(&expireTimer, SIGNAL(timeout()),
+            this, SLOT(expire()));
+
+    // clients that uninhibit and inhibit again right away shouldn't flip the state
+    releaseTimer.setSingleShot(true);
+    releaseTimer.setInterval(PK_INHIBITOR_RELEASE_DELAY);
+    connect(&releaseTimer, SIGNAL(timeout()),
+            this, SLOT(release()));
+
+    // free inhibitors as soon as the client leaves the bus
+    watcher = new QDBusServiceWatcher(this);
+    watcher->setConnection(QDBusConnection::sessionBus());
+    watcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+    connect(watcher, SIGNAL(serviceUnregistered(QString)),
+            this, SLOT(handleServiceUnregistered(QString)));
+}
+
+quint32 InhibitorRegistry::add(const QString &application,
+                               const QString &reason,
+                               const QString &owner)
+{
+    Client client;
+    client.cookie = genCookie();
+    client.application = application;
+    client.reason = reason;
+    client.owner = owner;
+    client.started = clock.elapsed();
+    client.expires = client.started + maxInhibit;
+    client.startTime = QDateTime::currentMSecsSinceEpoch();
+    clients.insert(client.cookie, client);
+    deadlines.push(Deadline(client.expires, client.cookie));
+
+    if (!owner.isEmpty()) {
+        if (!owners.contains(owner)) { watcher->addWatchedService(owner); }
+        owners.insert(owner, client.cookie);
+    }
+
+    scheduleExpiry();
+    emit added(client.cookie);
+    releaseTimer.stop();
+    if (!inhibited) {
+        inhibited = true;
+        emit inhibitedChanged(true);
+    }
+    return client.cookie;
+}
+
+bool InhibitorRegistry::remove(quint32 cookie)
+{
+    if (!clients.contains(cookie)) { return false; }
+    const Client client = clients.take(cookie);
+    usage[client.application] += clock.elapsed() - client.started;
+    if (!client.owner.isEmpty()) {
+        owners.remove(client.owner, cookie);
+        if (!owners.contains(client.owner)) {
+            watcher->removeWatchedService(client.owner);
+            pids.remove(client.owner);
+        }
+    }
+
+    // deadlines are dropped lazily, rebuild once they pile up
+    if (deadlines.size() > (size_t)(clients.size() * 2 + 16)) {
+        std::vector<Deadline> live;
+        live.reserve(clients.size());
+        QHashIterator<quint32, Client> i(clients);
+        while (i.hasNext()) {
+            i.next();
+            live.push_back(Deadline(i.value().expires, i.key()));
+        }
+        deadlines = std::priority_queue<Deadline,
+                                        std::vector<Deadline>,
+                                        std::greater<Deadline> >(std::greater<Deadline>(), live);
+    }
+
+    scheduleExpiry();
+    emit removed(cookie);
+    if (clients.isEmpty() && inhibited) { releaseTimer.start(); }
+    return true;
+}
+
+bool InhibitorRegistry::contains(quint32 cookie)
+{
+    return clients.contains(cookie);
+}
+
+bool InhibitorRegistry::isEmpty()
+{
+    return clients.isEmpty();
+}
+
+bool InhibitorRegistry::isInhibited()
+{
+    return inhibited;
+}
+
+int InhibitorRegistry::size()
+{
+    return clients.size();
+}
+
+const QList<InhibitorRegistry::Client> InhibitorRegistry::getClients()
+{
+    return clients.values();
+}
+
+qint64 InhibitorRegistry::elapsed()
+{
+    return clock.elapsed();
+}
+
+// total msec application has been inhibiting, including active inhibitors
+qint64 InhibitorRegistry::getUsage(const QString &application)
+{
+    qint64 result = usage.value(application);
+    qint64 now = clock.elapsed();
+    QHashIterator<quint32, Client> i(clients);
+    while (i.hasNext()) {
+        i.next();
+        if (i.value().application == application) { result += now - i.value().started; }
+    }
+    return result;
+}
+
+quint32 InhibitorRegistry::getPid(const QString &owner)
+{
+    if (owner.isEmpty()) { return 0; }
+    if (pids.contains(owner)) { return pids.value(owner); }
+    QDBusConnectionInterface *bus = QDBusConnection::sessionBus().interface();
+    if (!bus) { return 0; }
+    QDBusReply<uint> reply = bus->servicePid(owner);
+    if (!reply.isValid()) { return 0; }
+    // only cache while the owner is around, pids are reused
+    if (owners.contains(owner)) { pids[owner] = reply.value(); }
+    return reply.value();
+}
+
+quint32 InhibitorRegistry::genCookie()
+{
+    quint32 cookie;
+    do { cookie = QRandomGenerator::global()->generate(); }
+    while (cookie == 0 || clients.contains(cookie));
+    return cookie;
+}
+
+void InhibitorRegistry::scheduleExpiry()
+{
+    while (!deadlines.empty()) {
+        const Deadline next = deadlines.top();
+        if (clients.contains(next.second) &&
+            clients.value(next.second).expires == next.first) { break; }
+        deadlines.pop();
+    }
+    if (deadlines.empty()) {
+        expireTimer.stop();
+        return;
+    }
+    expireTimer.start((int)qMax(deadlines.top().first - clock.elapsed(), (qint64)0));
+}
+
+void InhibitorRegistry::expire()
+{
+    qint64 now = clock.elapsed();
+    while (!deadlines.empty() && deadlines.top().first <= now) {
+        const Deadline next = deadlines.top();
+        deadlines.pop();
+        if (!clients.contains(next.second) ||
+            clients.value(next.second).expires != next.first) { continue; }
+        qDebug() << "inhibitor expired" << next.second << clients.value(next.second).application;
+        remove(next.second);
+    }
+    scheduleExpiry();
+}
+
+void InhibitorRegistry::handleServiceUnregistered(const QString &service)
+{
+    const QList<quint32> cookies = owners.values(service);
+    if (cookies.isEmpty()) { return; }
+    qDebug() << "inhibitor owner left the bus" << service << cookies.size();
+    for (int i = 0; i < cookies.size(); ++i) { remove(cookies.at(i)); }
+}
+
+void InhibitorRegistry::release()
+{
+    if (!clients.isEmpty() || !inhibited) { return; }
+    inhibited = false;
+    emit inhibitedChanged(false);
+}
@@ -0,0 +1,91 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef POWERKIT_INHIBITOR_H
+#define POWERKIT_INHIBITOR_H
+
+#include <QObject>
+#include <QTimer>
+#include <QHash>
+#include <QMultiHash>
+#include <QList>
+#include <QElapsedTimer>
+#include <QString>
+#include <QDBusServiceWatcher>
+
+#include <queue>
+#include <vector>
+#include <functional>
+#include <utility>
+
+namespace PowerKit
+{
+    class InhibitorRegistry : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        struct Client
+        {
+            Client()
+                : cookie(0)
+                , started(0)
+                , expires(0)
+                , startTime(0) {}
+            quint32 cookie;
+            QString application;
+            QString reason;
+            QString owner;
+            qint64 started;
+            qint64 expires;
+            qint64 startTime;
+        };
+        explicit InhibitorRegistry(qint64 maxInhibit,
+                                   QObject *parent = nullptr);
+        quint32 add(const QString &application,
+                    const QString &reason,
+                    const QString &owner = QString());
+        bool remove(quint32 cookie);
+        bool contains(quint32 cookie);
+        bool isEmpty();
+        bool isInhibited();
+        int size();
+        const QList<Client> getClients();
+        qint64 elapsed();
+        qint64 getUsage(const QString &application);
+        quint32 getPid(const QString &owner);
+
+    private:
+        typedef std::pair<qint64, quint32> Deadline;
+        qint64 maxInhibit;
+        QElapsedTimer clock;
+        QHash<quint32, Client> clients;
+        QMultiHash<QString, quint32> owners;
+        QHash<QString, quint32> pids;
+        QHash<QString, qint64> usage;
+        std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline> > deadlines;
+        QTimer expireTimer;
+        QTimer releaseTimer;
+        QDBusServiceWatcher *watcher;
+        bool inhibited;
+
+    signals:
+        void added(quint32 cookie);
+        void removed(quint32 cookie);
+        void inhibitedChanged(bool inhibited);
+
+    private slots:
+        quint32 genCookie();
+        void scheduleExpiry();
+        void expire();
+        void handleServiceUnregistered(const QString &service);
+        void release();
+    };
+}
+
+#endif // POWERKIT_INHIBITOR_H
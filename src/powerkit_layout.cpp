@@ -0,0 +1,322 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "powerkit_layout.h"
+#include "powerkit_settings.h"
+#include "powerkit_common.h"
+
+#include <QCryptographicHash>
+#include <QMapIterator>
+#include <QRect>
+#include <QDebug>
+
+#include <climits>
+
+#define PK_LAYOUT_SEPARATOR "|"
+
+using namespace PowerKit;
+
+// put a width x height rect next to relative
+static const QRect placeRect(int action,
+                             const QRect &relative,
+                             int width,
+                             int height)
+{
+    switch (action) {
+    case randrLeftOf:
+        return QRect(relative.x() - width, relative.y(), width, height);
+    case randrRightOf:
+        return QRect(relative.x() + relative.width(), relative.y(), width, height);
+    case randrAbove:
+        return QRect(relative.x(), relative.y() - height, width, height);
+    case randrBelow:
+        return QRect(relative.x(), relative.y() + relative.height(), width, height);
+    default:;
+    }
+    return QRect(relative.x(), relative.y(), width, height);
+}
+
+// the reverse of placeRect, randrAuto if rect doesn't line up with relative
+static int findAction(const QRect &rect,
+                      const QRect &relative)
+{
+    if (rect.topLeft() == relative.topLeft()) { return randrSameAs; }
+    if (rect.y() == relative.y()) {
+        if (rect.x() + rect.width() == relative.x()) { return randrLeftOf; }
+        if (relative.x() + relative.width() == rect.x()) { return randrRightOf; }
+    }
+    if (rect.x() == relative.x()) {
+        if (rect.y() + rect.height() == relative.y()) { return randrAbove; }
+        if (relative.y() + relative.height() == rect.y()) { return randrBelow; }
+    }
+    return randrAuto;
+}
+
+Layout::Layout(RandR *randr,
+               QObject *parent)
+    : QObject(parent)
+    , randr(randr)
+    , enabled(false)
+{
+    connect(randr, SIGNAL(outputsChanged()),
+            this, SLOT(handleOutputsChanged()));
+}
+
+void Layout::setEnabled(bool enable)
+{
+    if (enabled == enable) { return; }
+    enabled = enable;
+    qDebug() << "display layout enabled?" << enabled;
+    currentSet.clear();
+    handleOutputsChanged();
+}
+
+const QString Layout::getKey(const RandR::Output &output)
+{
+    // not all monitors have an edid
+    if (output.edid.isEmpty()) { return output.name; }
+    return output.edid;
+}
+
+const QString Layout::getSetId()
+{
+    QStringList keys;
+    QMapIterator<QString, RandR::Output> i(randr->getOutputs());
+    while (i.hasNext()) {
+        i.next();
+        if (i.value().connected) { keys << getKey(i.value()); }
+    }
+    if (keys.isEmpty()) { return QString(); }
+    keys.sort();
+    return QString::fromLatin1(QCryptographicHash::hash(keys.join(",").toUtf8(),
+                                                        QCryptographicHash::Sha1).toHex());
+}
+
+const QMap<QString, Layout::Placement> Layout::readLayout(const QString &set)
+{
+    QMap<QString, Placement> result;
+    const QStringList entries = Settings::getValue(QString("%1/%2")
+                                                   .arg(CONF_DISPLAY_LAYOUTS, set)).toStringList();
+    for (int i = 0; i < entries.size(); ++i) {
+        const QStringList parts = entries.at(i).split(PK_LAYOUT_SEPARATOR);
+        if (parts.size() != 4) { continue; }
+        Placement placement;
+        placement.enabled = parts.at(1).toInt();
+        placement.action = parts.at(2).toInt();
+        placement.relative = parts.at(3);
+        result[parts.at(0)] = placement;
+    }
+    return result;
+}
+
+void Layout::handleOutputsChanged()
+{
+    if (!enabled) { return; }
+    const QString set = getSetId();
+    if (set.isEmpty()) { return; }
+    if (set == currentSet) {
+        save();
+        return;
+    }
+    qDebug() << "monitor set changed" << currentSet << set;
+    currentSet = set;
+    apply();
+}
+
+void Layout::handleDockedChanged(bool isDocked)
+{
+    if (!enabled) { return; }
+    qDebug() << "apply display layout, docked?" << isDocked;
+    currentSet = getSetId();
+    apply();
+}
+
+void Layout::apply()
+{
+    if (!enabled || currentSet.isEmpty()) { return; }
+
+    const QMap<QString, RandR::Output> outputs = randr->getOutputs();
+    const QMap<QString, Placement> layout = readLayout(currentSet);
+    QMap<QString, RandR::Config> configs;
+    QMap<QString, QString> names;
+    QMap<QString, QRect> sizes;
+    QMap<QString, QRect> placed;
+    QStringList pending;
+    QString anchor;
+
+    QMapIterator<QString, RandR::Output> i(outputs);
+    while (i.hasNext()) {
+        i.next();
+        const RandR::Output output = i.value();
+        const QString key = getKey(output);
+        if (!output.connected) {
+            // unplugged, release the crtc
+            if (output.crtc) { configs[output.name] = RandR::Config(); }
+            continue;
+        }
+        names[key] = output.name;
+
+        // the internal panel is switched by the lid handling
+        RandR::Config config;
+        bool active = output.crtc && output.mode;
+        config.enabled = output.internal ? active : layout.value(key).enabled;
+        config.mode = active ? output.mode : output.preferred;
+        if (active) { config.rotation = output.rotation; }
+        if (!config.enabled || !config.mode) {
+            configs[output.name] = RandR::Config();
+            continue;
+        }
+        configs[output.name] = config;
+        sizes[output.name] = QRect(0, 0,
+                                   active ? output.width : output.preferredWidth,
+                                   active ? output.height : output.preferredHeight);
+
+        // nothing stored for this set, only add what's new
+        if (layout.isEmpty() && active) {
+            placed[output.name] = sizes[output.name].translated(output.x, output.y);
+            continue;
+        }
+        if (output.internal) { anchor = output.name; }
+        pending << output.name;
+    }
+
+    if (placed.isEmpty() && !pending.isEmpty()) {
+        for (int p = 0; p < pending.size() && anchor.isEmpty(); ++p) {
+            const QString key = getKey(outputs.value(pending.at(p)));
+            if (layout.value(key).action == randrAuto) { anchor = pending.at(p); }
+        }
+        if (anchor.isEmpty()) { anchor = pending.first(); }
+        placed[anchor] = sizes.value(anchor);
+        pending.removeAll(anchor);
+    }
+
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        const QStringList waiting = pending;
+        for (int p = 0; p < waiting.size(); ++p) {
+            const QString name = waiting.at(p);
+            const Placement placement = layout.value(getKey(outputs.value(name)));
+            const QString relative = names.value(placement.relative);
+            if (placement.action == randrAuto || !placed.contains(relative)) { continue; }
+            placed[name] = placeRect(placement.action,
+                                     placed.value(relative),
+                                     sizes.value(name).width(),
+                                     sizes.value(name).height());
+            pending.removeAll(name);
+            progress = true;
+        }
+    }
+
+    // anything left goes to the right
+    for (int p = 0; p < pending.size(); ++p) {
+        int right = 0;
+        QMapIterator<QString, QRect> r(placed);
+        while (r.hasNext()) {
+            r.next();
+            right = qMax(right, r.value().x() + r.value().width());
+        }
+        placed[pending.at(p)] = sizes.value(pending.at(p)).translated(right, 0);
+    }
+
+    if (placed.isEmpty()) { return; }
+    int left = INT_MAX;
+    int top = INT_MAX;
+    QMapIterator<QString, QRect> r(placed);
+    while (r.hasNext()) {
+        r.next();
+        left = qMin(left, r.value().x());
+        top = qMin(top, r.value().y());
+    }
+    r.toFront();
+    while (r.hasNext()) {
+        r.next();
+        configs[r.key()].x = r.value().x() - left;
+        configs[r.key()].y = r.value().y() - top;
+    }
+
+    qDebug() << "apply display layout" << currentSet;
+    emit layoutApplied(randr->setConfig(configs));
+}
+
+void Layout::save()
+{
+    if (!enabled || currentSet.isEmpty()) { return; }
+
+    const QMap<QString, RandR::Output> outputs = randr->getOutputs();
+    QMap<QString, Placement> layout;
+    QMap<QString, QRect> active;
+    QString anchor;
+
+    QMapIterator<QString, RandR::Output> i(outputs);
+    while (i.hasNext()) {
+        i.next();
+        const RandR::Output output = i.value();
+        if (!output.connected) { continue; }
+        // a closed lid is not a layout
+        if (output.internal && !output.crtc) { return; }
+        Placement placement;
+        placement.enabled = output.crtc != 0;
+        layout[getKey(output)] = placement;
+        if (!placement.enabled) { continue; }
+        active[output.name] = QRect(output.x, output.y, output.width, output.height);
+        if (output.internal) { anchor = output.name; }
+    }
+    if (active.isEmpty()) { return; }
+
+    if (anchor.isEmpty()) {
+        QMapIterator<QString, QRect> a(active);
+        while (a.hasNext()) {
+            a.next();
+            if (anchor.isEmpty() ||
+                a.value().y() < active.value(anchor).y() ||
+                (a.value().y() == active.value(anchor).y() &&
+                 a.value().x() < active.value(anchor).x())) { anchor = a.key(); }
+        }
+    }
+
+    // walk from the anchor so the relations never loop
+    QStringList placed;
+    placed << anchor;
+    QStringList pending = active.keys();
+    pending.removeAll(anchor);
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        const QStringList waiting = pending;
+        for (int p = 0; p < waiting.size(); ++p) {
+            const QString name = waiting.at(p);
+            for (int q = 0; q < placed.size(); ++q) {
+                int action = findAction(active.value(name), active.value(placed.at(q)));
+                if (action == randrAuto) { continue; }
+                Placement &placement = layout[getKey(outputs.value(name))];
+                placement.action = action;
+                placement.relative = getKey(outputs.value(placed.at(q)));
+                placed << name;
+                pending.removeAll(name);
+                progress = true;
+                break;
+            }
+        }
+    }
+
+    QStringList entries;
+    QMapIterator<QString, Placement> l(layout);
+    while (l.hasNext()) {
+        l.next();
+        entries << QStringList({l.key(),
+                                QString::number(l.value().enabled),
+                                QString::number(l.value().action),
+                                l.value().relative}).join(PK_LAYOUT_SEPARATOR);
+    }
+
+    const QString key = QString("%1/%2").arg(CONF_DISPLAY_LAYOUTS, currentSet);
+    if (Settings::getValue(key).toStringList() == entries) { return; }
+    qDebug() << "save display layout" << currentSet << entries;
+    Settings::setValue(key, entries);
+}
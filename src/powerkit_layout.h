@@ -0,0 +1,60 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef POWERKIT_LAYOUT_H
+#define POWERKIT_LAYOUT_H
+
+#include <QObject>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+#include "powerkit_randr.h"
+
+namespace PowerKit
+{
+    class Layout : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        struct Placement
+        {
+            Placement()
+                : enabled(true)
+                , action(0) {}
+            bool enabled;
+            int action;
+            QString relative;
+        };
+        explicit Layout(RandR *randr,
+                        QObject *parent = nullptr);
+        void setEnabled(bool enabled);
+
+    private:
+        RandR *randr;
+        bool enabled;
+        QString currentSet;
+
+    signals:
+        void layoutApplied(bool success);
+
+    private slots:
+        const QString getKey(const RandR::Output &output);
+        const QString getSetId();
+        const QMap<QString, Placement> readLayout(const QString &set);
+
+    public slots:
+        void handleOutputsChanged();
+        void handleDockedChanged(bool isDocked);
+        void apply();
+        void save();
+    };
+}
+
+#endif // POWERKIT_LAYOUT_H
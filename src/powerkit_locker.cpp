@@ -0,0 +1,228 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "powerkit_locker.h"
+#include "powerkit_x11.h"
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QDebug>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+#define PK_LOCKER_MAP_TIMEOUT 10000 // msec
+#define PK_LOCKER_PID_ATOM "_NET_WM_PID"
+
+using namespace PowerKit;
+
+// watch top-level windows being mapped, without touching input
+static void selectMapEvents(bool enable)
+{
+    Display *dpy = X11::instance()->display();
+    if (!dpy) { return; }
+    XWindowAttributes attr;
+    if (!XGetWindowAttributes(dpy, DefaultRootWindow(dpy), &attr)) { return; }
+    long mask = attr.your_event_mask;
+    if (enable) { mask |= SubstructureNotifyMask; }
+    else { mask &= ~SubstructureNotifyMask; }
+    XSelectInput(dpy, DefaultRootWindow(dpy), mask);
+    X11::instance()->flush();
+}
+
+Locker *Locker::instance()
+{
+    static Locker *locker = nullptr;
+    if (!locker) { locker = new Locker(qApp); }
+    return locker;
+}
+
+Locker::Locker(QObject *parent)
+    : QObject(parent)
+    , process(nullptr)
+    , pid(0)
+    , active(false)
+    , mapped(false)
+    , window(0)
+    , latency(-1)
+{
+    mapTimer.setSingleShot(true);
+    mapTimer.setInterval(PK_LOCKER_MAP_TIMEOUT);
+    connect(&mapTimer, SIGNAL(timeout()),
+            this, SLOT(handleMapTimeout()));
+    connect(X11::instance(), SIGNAL(eventReceived(_XEvent*)),
+            this, SLOT(handleEvent(_XEvent*)));
+}
+
+// from lock() until the locker window goes away
+bool Locker::isLocked()
+{
+    return active;
+}
+
+bool Locker::isMapped()
+{
+    return mapped;
+}
+
+qint64 Locker::getPid()
+{
+    return pid;
+}
+
+// msec from spawn to mapped for the last lock, -1 if unknown
+qint64 Locker::getLatency()
+{
+    return latency;
+}
+
+bool Locker::lock(const QString &command)
+{
+    if (command.isEmpty()) { return false; }
+    if (isLocked()) {
+        qDebug() << "locker already running" << pid;
+        return false;
+    }
+
+    // never parented or deleted while running, so the screen
+    // stays locked if we go away
+    active = true;
+    process = new QProcess();
+    process->setProcessChannelMode(QProcess::ForwardedChannels);
+    connect(process, SIGNAL(started()),
+            this, SLOT(handleStarted()));
+    connect(process, SIGNAL(errorOccurred(QProcess::ProcessError)),
+            this, SLOT(handleError(QProcess::ProcessError)));
+    connect(process, SIGNAL(finished(int,QProcess::ExitStatus)),
+            this, SLOT(handleFinished(int,QProcess::ExitStatus)));
+
+    // listen before the locker can map its window
+    selectMapEvents(true);
+    mapped = false;
+    window = 0;
+    spawnClock.start();
+    process->start(command, QStringList());
+    return true;
+}
+
+void Locker::handleStarted()
+{
+    if (!process) { return; }
+    process->closeWriteChannel();
+    pid = process->processId();
+    qDebug() << "locker started" << process->program() << pid;
+    mapTimer.start();
+    emit lockedChanged(true);
+}
+
+void Locker::handleError(QProcess::ProcessError error)
+{
+    if (!process || error != QProcess::FailedToStart) { return; }
+    qWarning() << "failed to start locker" << process->program();
+    selectMapEvents(false);
+    process->deleteLater();
+    process = nullptr;
+    active = false;
+}
+
+// a wrapper or a forking locker may exit while its window stays up,
+// the window decides when we are unlocked
+void Locker::handleFinished(int exitCode,
+                            QProcess::ExitStatus exitStatus)
+{
+    qDebug() << "locker process exited" << pid << exitCode;
+    if (process) {
+        process->deleteLater();
+        process = nullptr;
+    }
+    if (mapped) { return; }
+    qWarning() << "locker exited before mapping a window" << pid;
+    if (exitStatus == QProcess::NormalExit && exitCode == 0 && mapTimer.isActive()) {
+        return; // give a forked locker time to show up
+    }
+    setUnlocked();
+}
+
+// the locker's own window, or a screen covering override-redirect
+// window if the command hands off to another process
+bool Locker::isLockerWindow(unsigned long candidate,
+                            bool overrideRedirect)
+{
+    Display *dpy = X11::instance()->display();
+    if (!dpy) { return false; }
+    Atom pidAtom = XInternAtom(dpy, PK_LOCKER_PID_ATOM, False);
+
+    // the window may already be gone
+    X11::instance()->trapErrors();
+    qint64 owner = 0;
+    Atom type;
+    int format;
+    unsigned long items, after;
+    unsigned char *data = nullptr;
+    if (XGetWindowProperty(dpy, candidate, pidAtom, 0, 1, False, XA_CARDINAL,
+                           &type, &format, &items, &after, &data) == Success &&
+        data && format == 32 && items == 1) {
+        owner = *reinterpret_cast<unsigned long*>(data);
+    }
+    if (data) { XFree(data); }
+    bool covers = false;
+    XWindowAttributes attr;
+    if (overrideRedirect && XGetWindowAttributes(dpy, candidate, &attr)) {
+        covers = attr.width >= WidthOfScreen(attr.screen) &&
+                 attr.height >= HeightOfScreen(attr.screen);
+    }
+    if (X11::instance()->untrapErrors() != 0) { return false; }
+
+    return (owner > 0 && owner == pid) || covers;
+}
+
+void Locker::handleEvent(_XEvent *event)
+{
+    if (!active) { return; }
+    if (event->type == MapNotify && !mapped) {
+        if (!isLockerWindow(event->xmap.window,
+                            event->xmap.override_redirect)) { return; }
+        mapped = true;
+        window = event->xmap.window;
+        latency = spawnClock.elapsed();
+        mapTimer.stop();
+        qDebug() << "locker mapped" << pid << latency;
+        emit lockMapped(latency);
+    } else if (mapped &&
+               ((event->type == UnmapNotify && event->xunmap.window == window) ||
+                (event->type == DestroyNotify && event->xdestroywindow.window == window))) {
+        setUnlocked();
+    }
+}
+
+// without a window the process lifetime is all we have
+void Locker::handleMapTimeout()
+{
+    qWarning() << "locker did not map a window" << pid;
+    if (!process) { setUnlocked(); }
+}
+
+void Locker::setUnlocked()
+{
+    qDebug() << "unlocked" << pid;
+    mapTimer.stop();
+    selectMapEvents(false);
+    if (process) {
+        // a process that outlives its window cleans up after itself
+        disconnect(process, nullptr, this, nullptr);
+        connect(process, SIGNAL(finished(int,QProcess::ExitStatus)),
+                process, SLOT(deleteLater()));
+        process = nullptr;
+    }
+    bool wasStarted = pid > 0;
+    active = false;
+    pid = 0;
+    mapped = false;
+    window = 0;
+    if (wasStarted) { emit lockedChanged(false); }
+}
@@ -0,0 +1,64 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef POWERKIT_LOCKER_H
+#define POWERKIT_LOCKER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QString>
+#include <QProcess>
+
+union _XEvent;
+
+namespace PowerKit
+{
+    class Locker : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        static Locker *instance();
+        bool isLocked();
+        bool isMapped();
+        qint64 getPid();
+        qint64 getLatency();
+
+    private:
+        explicit Locker(QObject *parent = nullptr);
+        bool isLockerWindow(unsigned long candidate,
+                            bool overrideRedirect);
+        QProcess *process;
+        qint64 pid;
+        bool active;
+        bool mapped;
+        unsigned long window;
+        qint64 latency;
+        QElapsedTimer spawnClock;
+        QTimer mapTimer;
+
+    signals:
+        void lockedChanged(bool locked);
+        void lockMapped(qint64 latency);
+
+    private slots:
+        void handleStarted();
+        void handleError(QProcess::ProcessError error);
+        void handleFinished(int exitCode,
+                            QProcess::ExitStatus exitStatus);
+        void handleEvent(_XEvent *event);
+        void handleMapTimeout();
+        void setUnlocked();
+
+    public slots:
+        bool lock(const QString &command);
+    };
+}
+
+#endif // POWERKIT_LOCKER_H
@@ -9,19 +9,27 @@
 #include "powerkit_manager.h"
 #include "powerkit_common.h"
 #include "powerkit_settings.h"
+#include "powerkit_screensaver.h"
+#include "powerkit_locker.h"
+#include "powerkit_backlight.h"
 
 #include <QDBusInterface>
 #include <QDBusMessage>
 #include <QDBusPendingReply>
 #include <QXmlStreamReader>
-#include <QProcess>
 #include <QMapIterator>
 #include <QDebug>
 #include <QDBusReply>
+#include <QDBusObjectPath>
+#include <QCoreApplication>
 
 #define LOGIND_PATH "/org/freedesktop/login1"
 #define LOGIND_MANAGER "org.freedesktop.login1.Manager"
 #define LOGIND_DOCKED "Docked"
+#define LOGIND_SESSION "org.freedesktop.login1.Session"
+#define LOGIND_SESSION_AUTO "/org/freedesktop/login1/session/auto"
+#define LOGIND_SESSION_BY_PID "GetSessionByPID"
+#define LOGIND_SET_IDLE_HINT "SetIdleHint"
 
 #define UPOWER_PATH "/org/freedesktop/UPower"
 #define UPOWER_MANAGER "org.freedesktop.UPower"
@@ -62,23 +70,30 @@
 #define PK_SUSPEND_THEN_HIBERNATE "SuspendThenHibernate"
 #define PK_NO_BACKEND "No backend available."
 #define PK_NO_ACTION "Action no available."
-
-#define TIMEOUT_CHECK 60000
+#define PK_INHIBITORS_UPDATE_DELAY 500 // msec
 
 using namespace PowerKit;
 
 Manager::Manager(QObject *parent) : QObject(parent)
+  , backlights(nullptr)
   , upower(nullptr)
   , logind(nullptr)
+  , session(nullptr)
+  , watcher(nullptr)
   , wasDocked(false)
   , wasLidClosed(false)
   , wasOnBattery(false)
-{
+  , wantIdleLock(false)
+  , idleHint(false)
+{
+    connect(Locker::instance(), SIGNAL(lockedChanged(bool)),
+            this, SIGNAL(isLockedChanged(bool)));
+    // inhibit/uninhibit cycles come in bursts, tell clients once
+    inhibitorsTimer.setSingleShot(true);
+    inhibitorsTimer.setInterval(PK_INHIBITORS_UPDATE_DELAY);
+    connect(&inhibitorsTimer, SIGNAL(timeout()),
+            this, SLOT(updateInhibitors()));
     setup();
-    timer.setInterval(TIMEOUT_CHECK);
-    connect(&timer, SIGNAL(timeout()),
-            this, SLOT(check()));
-    timer.start();
 }
 
 Manager::~Manager()
@@ -92,6 +107,17 @@ QMap<QString, Device *> Manager::getDevices()
     return devices;
 }
 
+void Manager::addInhibitors(const QString &type,
+                            InhibitorRegistry *registry)
+{
+    registries[type] = registry;
+}
+
+void Manager::setBacklights(BacklightSet *set)
+{
+    backlights = set;
+}
+
 bool Manager::canLogind(const QString &method)
 {
     if (!logind->isValid() || method.isEmpty()) { return false; }
@@ -152,6 +178,40 @@ void Manager::setup()
         return;
     }
 
+    // re-setup logind/upower as soon as they (re)appear on the bus
+    watcher = new QDBusServiceWatcher(this);
+    watcher->setConnection(system);
+    watcher->setWatchMode(QDBusServiceWatcher::WatchForOwnerChange);
+    watcher->addWatchedService(POWERKIT_LOGIND_SERVICE);
+    watcher->addWatchedService(POWERKIT_UPOWER_SERVICE);
+    connect(watcher,
+            SIGNAL(serviceOwnerChanged(QString,QString,QString)),
+            this,
+            SLOT(handleServiceOwnerChanged(QString,QString,QString)));
+
+    setupUPower();
+    setupLogind();
+
+    if (!upower->isValid()) {
+        emit Error(tr("Failed to connect to upower"));
+        return;
+    }
+    if (!logind->isValid()) {
+        emit Error(tr("Failed to connect to logind"));
+        return;
+    }
+
+    wasDocked = IsDocked();
+    wasLidClosed = LidIsClosed();
+    wasOnBattery = OnBattery();
+
+    scan();
+}
+
+void Manager::setupUPower()
+{
+    QDBusConnection system = QDBusConnection::systemBus();
+
     system.connect(POWERKIT_UPOWER_SERVICE,
                    UPOWER_PATH,
                    POWERKIT_UPOWER_SERVICE,
@@ -183,29 +243,25 @@ void Manager::setup()
                    this,
                    SLOT(propertiesChanged()));
 
+    if (upower) { upower->deleteLater(); }
     upower = new QDBusInterface(POWERKIT_UPOWER_SERVICE,
                                 UPOWER_PATH,
                                 UPOWER_MANAGER,
                                 system,
                                 this);
+}
+
+void Manager::setupLogind()
+{
+    QDBusConnection system = QDBusConnection::systemBus();
+
+    if (logind) { logind->deleteLater(); }
     logind = new QDBusInterface(POWERKIT_LOGIND_SERVICE,
                                 LOGIND_PATH,
                                 LOGIND_MANAGER,
                                 system,
                                 this);
-
-    if (!upower->isValid()) {
-        emit Error(tr("Failed to connect to upower"));
-        return;
-    }
-    if (!logind->isValid()) {
-        emit Error(tr("Failed to connect to logind"));
-        return;
-    }
-
-    wasDocked = IsDocked();
-    wasLidClosed = LidIsClosed();
-    wasOnBattery = OnBattery();
+    if (!logind->isValid()) { return; }
 
     connect(logind,
             SIGNAL(PrepareForSleep(bool)),
@@ -214,14 +270,58 @@ void Manager::setup()
 
     if (!suspendLock) { registerSuspendLock(); }
     if (!lidLock) { registerLidLock(); }
-
-    scan();
-}
-
-void Manager::check()
-{
-    if (!suspendLock) { registerSuspendLock(); }
-    if (!lidLock) { registerLidLock(); }
+    if (wantIdleLock && !idleLock) { registerIdleLock(); }
+
+    setupSession();
+}
+
+void Manager::setupSession()
+{
+    if (session) {
+        session->deleteLater();
+        session = nullptr;
+    }
+    if (!logind || !logind->isValid()) { return; }
+
+    // resolve our session once and keep the proxy around
+    QDBusReply<QDBusObjectPath> reply = logind->call(LOGIND_SESSION_BY_PID,
+                                                     (quint32)QCoreApplication::applicationPid());
+    QString path = reply.isValid() ? reply.value().path() : QString(LOGIND_SESSION_AUTO);
+    session = new QDBusInterface(POWERKIT_LOGIND_SERVICE,
+                                 path,
+                                 LOGIND_SESSION,
+                                 QDBusConnection::systemBus(),
+                                 this);
+    qDebug() << "logind session" << path << session->isValid();
+    BacklightRegistry::instance()->setSession(session);
+    if (idleHint) { handleIdleHintChanged(idleHint); }
+}
+
+void Manager::handleServiceOwnerChanged(const QString &service,
+                                        const QString &oldOwner,
+                                        const QString &newOwner)
+{
+    qDebug() << "service owner changed" << service << oldOwner << newOwner;
+    if (service == POWERKIT_LOGIND_SERVICE) {
+        // any inhibitor we had died with the old owner
+        ReleaseSuspendLock();
+        ReleaseLidLock();
+        ReleaseIdleLock();
+        if (newOwner.isEmpty()) {
+            emit Warning(tr("logind disappeared from the system bus"));
+            return;
+        }
+        setupLogind();
+    } else if (service == POWERKIT_UPOWER_SERVICE) {
+        if (newOwner.isEmpty()) {
+            emit Warning(tr("upower disappeared from the system bus"));
+            return;
+        }
+        setupUPower();
+        clearDevices();
+        scan();
+    }
+    propertiesChanged();
 }
 
 void Manager::scan()
@@ -364,9 +464,7 @@ void Manager::handleNewInhibitScreenSaver(const QString &application,
                                           quint32 cookie)
 {
     qDebug() << "new screensaver cookie" << application << reason << cookie;
-    Q_UNUSED(reason)
-    ssInhibitors[cookie] = application;
-    emit UpdatedInhibitors();
+    inhibitorsTimer.start();
 }
 
 void Manager::handleNewInhibitPowerManagement(const QString &application,
@@ -374,27 +472,19 @@ void Manager::handleNewInhibitPowerManagement(const QString &application,
                                               quint32 cookie)
 {
     qDebug() << "new power cookie" << application << reason << cookie;
-    Q_UNUSED(reason)
-    pmInhibitors[cookie] = application;
-    emit UpdatedInhibitors();
+    inhibitorsTimer.start();
 }
 
 void Manager::handleDelInhibitScreenSaver(quint32 cookie)
 {
     qDebug() << "remove screensaver cookie" << cookie;
-    if (ssInhibitors.contains(cookie)) {
-        ssInhibitors.remove(cookie);
-        emit UpdatedInhibitors();
-    }
+    inhibitorsTimer.start();
 }
 
 void Manager::handleDelInhibitPowerManagement(quint32 cookie)
 {
     qDebug() << "remove power cookie" << cookie;
-    if (pmInhibitors.contains(cookie)) {
-        pmInhibitors.remove(cookie);
-        emit UpdatedInhibitors();
-    }
+    inhibitorsTimer.start();
 }
 
 bool Manager::registerSuspendLock()
@@ -439,6 +529,43 @@ bool Manager::registerLidLock()
     return false;
 }
 
+bool Manager::registerIdleLock()
+{
+    if (idleLock) { return false; }
+    qDebug() << "register idle lock";
+    QDBusReply<QDBusUnixFileDescriptor> reply;
+    if (logind->isValid()) {
+        reply = logind->call("Inhibit",
+                             "idle:sleep",
+                             "powerkit",
+                             "Applications are inhibiting power management",
+                             "block");
+    }
+    if (reply.isValid()) {
+        idleLock.reset(new QDBusUnixFileDescriptor(reply.value()));
+        return true;
+    } else {
+        emit Warning(tr("Failed to set idle lock: %1").arg(reply.error().message()));
+    }
+    return false;
+}
+
+// mirror the aggregate power inhibit state to logind
+void Manager::handleHasInhibitChanged(bool has_inhibit)
+{
+    wantIdleLock = has_inhibit;
+    if (wantIdleLock) { registerIdleLock(); }
+    else { ReleaseIdleLock(); }
+}
+
+void Manager::handleIdleHintChanged(bool idle)
+{
+    idleHint = idle;
+    if (!session || !session->isValid()) { return; }
+    qDebug() << "set idle hint" << idle;
+    session->asyncCall(LOGIND_SET_IDLE_HINT, idle);
+}
+
 bool Manager::HasSuspendLock()
 {
     return suspendLock;
@@ -449,6 +576,11 @@ bool Manager::HasLidLock()
     return lidLock;
 }
 
+bool Manager::HasIdleLock()
+{
+    return idleLock;
+}
+
 bool Manager::CanRestart()
 {
     if (logind->isValid()) { return canLogind(PK_CAN_RESTART); }
@@ -573,11 +705,33 @@ double Manager::BatteryLeft()
 void Manager::LockScreen()
 {
     qDebug() << "screen lock";
-    QProcess::startDetached(Settings::getValue(CONF_SCREENSAVER_LOCK_CMD,
-                                               POWERKIT_SCREENSAVER_LOCK_CMD).toString(),
-                            QStringList());
-    QProcess::execute("xset",
-                      QStringList() << "dpms" << "force" << "off");
+    Locker::instance()->lock(Settings::getConfig().screensaverLockCmd);
+    ScreenSaver::setDisplaysOff(true);
+}
+
+bool Manager::IsLocked()
+{
+    return Locker::instance()->isLocked();
+}
+
+qlonglong Manager::GetLockLatency()
+{
+    return Locker::instance()->getLatency();
+}
+
+// hotkeys land here so steps are coalesced with the tray wheel
+bool Manager::BrightnessUp()
+{
+    if (!backlights || backlights->getDevice().isEmpty()) { return false; }
+    backlights->step(POWERKIT_BACKLIGHT_STEP);
+    return true;
+}
+
+bool Manager::BrightnessDown()
+{
+    if (!backlights || backlights->getDevice().isEmpty()) { return false; }
+    backlights->step(-POWERKIT_BACKLIGHT_STEP);
+    return true;
 }
 
 bool Manager::HasBattery()
@@ -645,40 +799,72 @@ void Manager::UpdateConfig()
     emit Update();
 }
 
-const QStringList Manager::GetScreenSaverInhibitors()
+// only tell clients when the set of inhibiting applications changed
+void Manager::updateInhibitors()
+{
+    QStringList applications = getApplications("screensaver") + getApplications("power");
+    applications.removeDuplicates();
+    applications.sort();
+    if (applications == inhibitorApplications) { return; }
+    inhibitorApplications = applications;
+    emit UpdatedInhibitors();
+}
+
+// the registries own the inhibitors, expiry and owner exits included
+const QStringList Manager::getApplications(const QString &type)
 {
     QStringList result;
-    QMapIterator<quint32, QString> i(ssInhibitors);
-    while (i.hasNext()) {
-        i.next();
-        result << i.value();
-    }
+    InhibitorRegistry *registry = registries.value(type);
+    if (!registry) { return result; }
+    const QList<InhibitorRegistry::Client> clients = registry->getClients();
+    for (int i = 0; i < clients.size(); ++i) { result << clients.at(i).application; }
     return result;
 }
 
+const QStringList Manager::GetScreenSaverInhibitors()
+{
+    return getApplications("screensaver");
+}
+
 const QStringList Manager::GetPowerManagementInhibitors()
 {
-    QStringList result;
-    QMapIterator<quint32, QString> i(pmInhibitors);
+    return getApplications("power");
+}
+
+QMap<quint32, QString> Manager::GetInhibitors()
+{
+    QMap<quint32, QString> result;
+    QMapIterator<QString, InhibitorRegistry*> i(registries);
     while (i.hasNext()) {
         i.next();
-        result << i.value();
+        const QList<InhibitorRegistry::Client> clients = i.value()->getClients();
+        for (int c = 0; c < clients.size(); ++c) {
+            result.insert(clients.at(c).cookie, clients.at(c).application);
+        }
     }
     return result;
 }
 
-QMap<quint32, QString> Manager::GetInhibitors()
+QVariantList Manager::GetInhibitorDetails()
 {
-    QMap<quint32, QString> result;
-    QMapIterator<quint32, QString> ss(ssInhibitors);
-    while (ss.hasNext()) {
-        ss.next();
-        result.insert(ss.key(), ss.value());
-    }
-    QMapIterator<quint32, QString> pm(pmInhibitors);
-    while (pm.hasNext()) {
-        pm.next();
-        result.insert(pm.key(), pm.value());
+    QVariantList result;
+    QMapIterator<QString, InhibitorRegistry*> i(registries);
+    while (i.hasNext()) {
+        i.next();
+        const QList<InhibitorRegistry::Client> clients = i.value()->getClients();
+        for (int c = 0; c < clients.size(); ++c) {
+            const InhibitorRegistry::Client client = clients.at(c);
+            QVariantMap details;
+            details["cookie"] = client.cookie;
+            details["application"] = client.application;
+            details["reason"] = client.reason;
+            details["type"] = i.key();
+            details["sender"] = client.owner;
+            details["pid"] = i.value()->getPid(client.owner);
+            details["started"] = QDateTime::fromMSecsSinceEpoch(client.startTime).toString(Qt::ISODate);
+            details["seconds"] = (qlonglong)(i.value()->getUsage(client.application) / 1000);
+            result << details;
+        }
     }
     return result;
 }
@@ -694,3 +880,10 @@ void Manager::ReleaseLidLock()
     qDebug() << "release lid lock";
     lidLock.reset(nullptr);
 }
+
+void Manager::ReleaseIdleLock()
+{
+    if (!idleLock) { return; }
+    qDebug() << "release idle lock";
+    idleLock.reset(nullptr);
+}
@@ -18,8 +18,12 @@
 #include <QTimer>
 #include <QDateTime>
 #include <QDBusUnixFileDescriptor>
+#include <QDBusServiceWatcher>
+#include <QVariant>
 
 #include "powerkit_device.h"
+#include "powerkit_inhibitor.h"
+#include "powerkit_brightness.h"
 
 namespace PowerKit
 {
@@ -31,16 +35,22 @@ namespace PowerKit
         explicit Manager(QObject *parent = 0);
         ~Manager();
         QMap<QString, Device*> getDevices();
+        void addInhibitors(const QString &type,
+                           InhibitorRegistry *registry);
+        void setBacklights(BacklightSet *set);
 
     private:
         QMap<QString, Device*> devices;
-        QMap<quint32,QString> ssInhibitors;
-        QMap<quint32,QString> pmInhibitors;
+        BacklightSet *backlights;
+        QMap<QString, InhibitorRegistry*> registries;
+        QStringList inhibitorApplications;
+        QTimer inhibitorsTimer;
 
         QDBusInterface *upower;
         QDBusInterface *logind;
+        QDBusInterface *session;
 
-        QTimer timer;
+        QDBusServiceWatcher *watcher;
 
         bool wasDocked;
         bool wasLidClosed;
@@ -48,6 +58,9 @@ namespace PowerKit
 
         QScopedPointer<QDBusUnixFileDescriptor> suspendLock;
         QScopedPointer<QDBusUnixFileDescriptor> lidLock;
+        QScopedPointer<QDBusUnixFileDescriptor> idleLock;
+        bool wantIdleLock;
+        bool idleHint;
 
     signals:
         void Update();
@@ -67,6 +80,7 @@ namespace PowerKit
         void isDockedChanged(bool isDocked);
         void isLidClosedChanged(bool isClosed);
         void isOnBatteryChanged(bool onBattery);
+        void isLockedChanged(bool isLocked);
 
 
     private slots:
@@ -75,7 +89,12 @@ namespace PowerKit
 
         QStringList find();
         void setup();
-        void check();
+        void setupUPower();
+        void setupLogind();
+        void setupSession();
+        void handleServiceOwnerChanged(const QString &service,
+                                       const QString &oldOwner,
+                                       const QString &newOwner);
         void scan();
 
         void deviceAdded(const QDBusObjectPath &obj);
@@ -98,10 +117,16 @@ namespace PowerKit
 
         bool registerSuspendLock();
         bool registerLidLock();
+        bool registerIdleLock();
+        void handleHasInhibitChanged(bool has_inhibit);
+        void handleIdleHintChanged(bool idle);
+        const QStringList getApplications(const QString &type);
+        void updateInhibitors();
 
     public slots:
         bool HasSuspendLock();
         bool HasLidLock();
+        bool HasIdleLock();
 
         bool CanRestart();
         bool CanPowerOff();
@@ -123,6 +148,10 @@ namespace PowerKit
         bool OnBattery();
         double BatteryLeft();
         void LockScreen();
+        bool IsLocked();
+        qlonglong GetLockLatency();
+        bool BrightnessUp();
+        bool BrightnessDown();
         bool HasBattery();
         qlonglong TimeToEmpty();
         qlonglong TimeToFull();
@@ -132,8 +161,10 @@ namespace PowerKit
         const QStringList GetScreenSaverInhibitors();
         const QStringList GetPowerManagementInhibitors();
         QMap<quint32, QString> GetInhibitors();
+        QVariantList GetInhibitorDetails();
         void ReleaseSuspendLock();
         void ReleaseLidLock();
+        void ReleaseIdleLock();
     };
 }
 
@@ -0,0 +1,122 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "powerkit_pipeline.h"
+#include "powerkit_common.h"
+
+#include <QMapIterator>
+#include <QDebug>
+
+using namespace PowerKit;
+
+IdlePipeline::IdlePipeline(QObject *parent)
+    : QObject(parent)
+    , idleMonitor(nullptr)
+    , stage(idleActive)
+    , screenInhibited(false)
+    , powerInhibited(false)
+{
+    idleMonitor = new IdleMonitor(this);
+    connect(idleMonitor, SIGNAL(timeoutReached(int,quint32)),
+            this, SLOT(handleIdleTimeout(int,quint32)));
+    connect(idleMonitor, SIGNAL(resumingFromIdle()),
+            this, SLOT(handleResumingFromIdle()));
+}
+
+void IdlePipeline::setTimeout(int stage,
+                              quint32 secs)
+{
+    QMapIterator<int, int> i(alarms);
+    while (i.hasNext()) {
+        i.next();
+        if (i.value() != stage) { continue; }
+        idleMonitor->removeTimeout(i.key());
+        alarms.remove(i.key());
+    }
+    thresholds.remove(stage);
+    if (secs == 0) { return; }
+    thresholds[stage] = secs * 1000;
+    alarms[idleMonitor->addTimeout(secs * 1000)] = stage;
+}
+
+int IdlePipeline::getStage()
+{
+    return stage;
+}
+
+void IdlePipeline::handleIdleTimeout(int id, quint32 msec)
+{
+    Q_UNUSED(msec)
+    if (!alarms.contains(id)) { return; }
+    advance(alarms.value(id));
+}
+
+void IdlePipeline::handleResumingFromIdle()
+{
+    reset();
+}
+
+bool IdlePipeline::isInhibited(int target)
+{
+    // screen inhibitors keep the whole session awake
+    if (screenInhibited) { return true; }
+    return target == idleSuspend && powerInhibited;
+}
+
+// walk through every stage up to target, in order
+void IdlePipeline::advance(int target)
+{
+    if (!thresholds.contains(target)) { return; }
+    for (int next = stage + 1; next <= target; ++next) {
+        if (!thresholds.contains(next) ||
+            thresholds.value(next) > thresholds.value(target) ||
+            isInhibited(next)) { continue; }
+        int previous = stage;
+        stage = next;
+        qDebug() << "idle stage" << previous << stage;
+        if (previous < idleBlank && stage >= idleBlank) { emit idleHintChanged(true); }
+        emit stageChanged(stage, previous);
+    }
+}
+
+// thresholds may have passed while we were inhibited
+void IdlePipeline::catchUp()
+{
+    quint32 idle = idleMonitor->getIdleTime();
+    int target = idleActive;
+    QMapIterator<int, quint32> i(thresholds);
+    while (i.hasNext()) {
+        i.next();
+        if (i.value() <= idle && i.key() > target) { target = i.key(); }
+    }
+    if (target > stage) { advance(target); }
+}
+
+void IdlePipeline::setScreenInhibited(bool inhibited)
+{
+    if (screenInhibited == inhibited) { return; }
+    screenInhibited = inhibited;
+    if (!screenInhibited) { catchUp(); }
+}
+
+void IdlePipeline::setPowerInhibited(bool inhibited)
+{
+    if (powerInhibited == inhibited) { return; }
+    powerInhibited = inhibited;
+    if (!powerInhibited) { catchUp(); }
+}
+
+void IdlePipeline::reset()
+{
+    if (stage == idleActive) { return; }
+    int previous = stage;
+    stage = idleActive;
+    qDebug() << "idle stage" << previous << stage;
+    if (previous >= idleBlank) { emit idleHintChanged(false); }
+    emit stageChanged(stage, previous);
+}
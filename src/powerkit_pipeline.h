@@ -0,0 +1,55 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef POWERKIT_PIPELINE_H
+#define POWERKIT_PIPELINE_H
+
+#include <QObject>
+#include <QMap>
+
+#include "powerkit_idle.h"
+
+namespace PowerKit
+{
+    class IdlePipeline : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        explicit IdlePipeline(QObject *parent = nullptr);
+        void setTimeout(int stage,
+                        quint32 secs);
+        int getStage();
+
+    private:
+        IdleMonitor *idleMonitor;
+        QMap<int, int> alarms;
+        QMap<int, quint32> thresholds;
+        int stage;
+        bool screenInhibited;
+        bool powerInhibited;
+
+    signals:
+        void stageChanged(int stage, int previous);
+        void idleHintChanged(bool idle);
+
+    private slots:
+        void handleIdleTimeout(int id, quint32 msec);
+        void handleResumingFromIdle();
+        bool isInhibited(int target);
+        void advance(int target);
+        void catchUp();
+
+    public slots:
+        void setScreenInhibited(bool inhibited);
+        void setPowerInhibited(bool inhibited);
+        void reset();
+    };
+}
+
+#endif // POWERKIT_PIPELINE_H
@@ -7,86 +7,59 @@
 */
 
 #include "powerkit_powermanagement.h"
-#include <QMapIterator>
 #include <QDBusConnection>
+#include <QDBusMessage>
 #include <QCoreApplication>
 #include <QProcess>
-#include <QRandomGenerator>
 #include <QDebug>
 
 #include "powerkit_common.h"
 
-#define PM_TIMEOUT 60000
-#define PM_MAX_INHIBIT 18000
+#define PM_MAX_INHIBIT 18000000 // msec
 
 using namespace PowerKit;
 
-PowerManagement::PowerManagement(QObject *parent) : QObject(parent)
+PowerManagement::PowerManagement(QObject *parent)
+    : QObject(parent)
+    , inhibitors(nullptr)
 {
-    timer.setInterval(PM_TIMEOUT);
-    connect(&timer, SIGNAL(timeout()),
-            this, SLOT(timeOut()));
-    timer.start();
+    inhibitors = new InhibitorRegistry(PM_MAX_INHIBIT, this);
+    connect(inhibitors, SIGNAL(removed(quint32)),
+            this, SLOT(handleInhibitorRemoved(quint32)));
+    connect(inhibitors, SIGNAL(inhibitedChanged(bool)),
+            this, SIGNAL(HasInhibitChanged(bool)));
 }
 
-quint32 PowerManagement::genCookie()
+InhibitorRegistry *PowerManagement::getInhibitors()
 {
-    quint32 cookie = QRandomGenerator::global()->generate();
-    while (!clients.contains(cookie)) {
-        if (!clients.contains(cookie)) { clients[cookie] = QTime::currentTime(); }
-        else { cookie = QRandomGenerator::global()->generate(); }
-    }
-    return cookie;
-}
-
-void PowerManagement::checkForExpiredClients()
-{
-    QMapIterator<quint32, QTime> client(clients);
-    while (client.hasNext()) {
-        client.next();
-        if (client.value()
-            .secsTo(QTime::currentTime())>=PM_MAX_INHIBIT) {
-            clients.remove(client.key());
-        }
-    }
+    return inhibitors;
 }
 
 bool PowerManagement::canInhibit()
 {
-    checkForExpiredClients();
-    if (clients.size()>0) { return true; }
-    return false;
+    return inhibitors->isInhibited();
 }
 
-void PowerManagement::timeOut()
+void PowerManagement::handleInhibitorRemoved(quint32 cookie)
 {
-    if (canInhibit()) { SimulateUserActivity(); }
-}
-
-void PowerManagement::SimulateUserActivity()
-{
-    qDebug() << "SimulateUserActivity";
-    emit HasInhibitChanged(true);
+    emit removedInhibit(cookie);
 }
 
 quint32 PowerManagement::Inhibit(const QString &application,
                                  const QString &reason)
 {
     qDebug() << "Inhibit" << application << reason;
-    quint32 cookie = genCookie();
-    timeOut();
+    quint32 cookie = inhibitors->add(application,
+                                     reason,
+                                     calledFromDBus() ? message().service() : QString());
     emit newInhibit(application, reason, cookie);
-    emit HasInhibitChanged(canInhibit());
     return cookie;
 }
 
 void PowerManagement::UnInhibit(quint32 cookie)
 {
     qDebug() << "UnInhibit" << cookie;
-    if (clients.contains(cookie)) { clients.remove(cookie); }
-    timeOut();
-    emit removedInhibit(cookie);
-    emit HasInhibitChanged(canInhibit());
+    inhibitors->remove(cookie);
 }
 
 bool PowerManagement::HasInhibit()
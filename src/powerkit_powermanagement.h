@@ -10,23 +10,23 @@
 #define POWERKIT_POWERMANAGEMENT_H
 
 #include <QObject>
-#include <QTimer>
-#include <QMap>
-#include <QTime>
 #include <QString>
+#include <QDBusContext>
+
+#include "powerkit_inhibitor.h"
 
 namespace PowerKit
 {
-    class PowerManagement : public QObject
+    class PowerManagement : public QObject, protected QDBusContext
     {
         Q_OBJECT
 
     public:
         explicit PowerManagement(QObject *parent = NULL);
+        InhibitorRegistry *getInhibitors();
 
     private:
-        QTimer timer;
-        QMap<quint32, QTime> clients;
+        InhibitorRegistry *inhibitors;
 
     signals:
         void HasInhibitChanged(bool has_inhibit_changed);
@@ -36,13 +36,10 @@ namespace PowerKit
         void removedInhibit(quint32 cookie);
 
     private slots:
-        quint32 genCookie();
-        void checkForExpiredClients();
         bool canInhibit();
-        void timeOut();
+        void handleInhibitorRemoved(quint32 cookie);
 
     public slots:
-        void SimulateUserActivity();
         quint32 Inhibit(const QString &application,
                         const QString &reason);
         void UnInhibit(quint32 cookie);
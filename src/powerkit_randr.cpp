@@ -0,0 +1,557 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "powerkit_randr.h"
+#include "powerkit_x11.h"
+
+#include <QCryptographicHash>
+#include <QByteArray>
+#include <QVector>
+#include <QDebug>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/Xrandr.h>
+
+#define PK_RANDR_EDID_LENGTH 128 // in 32-bit units, covers base block + extensions
+#define PK_RANDR_CONNECTOR_PANEL "Panel"
+#define PK_RANDR_PANEL_NAMES {"eDP", "LVDS", "DSI"}
+
+using namespace PowerKit;
+
+static void getModeSize(XRRScreenResources *sr,
+                        RRMode mode,
+                        Rotation rotation,
+                        int *width,
+                        int *height)
+{
+    *width = 0;
+    *height = 0;
+    for (int i = 0; i < sr->nmode; ++i) {
+        if (sr->modes[i].id != mode) { continue; }
+        bool swap = rotation & (RR_Rotate_90 | RR_Rotate_270);
+        *width = swap ? sr->modes[i].height : sr->modes[i].width;
+        *height = swap ? sr->modes[i].width : sr->modes[i].height;
+        return;
+    }
+}
+
+static void setScreenSize(Display *dpy,
+                          int width,
+                          int height)
+{
+    int screen = DefaultScreen(dpy);
+    Window root = RootWindow(dpy, screen);
+    int minWidth, minHeight, maxWidth, maxHeight;
+    if (XRRGetScreenSizeRange(dpy, root, &minWidth, &minHeight, &maxWidth, &maxHeight)) {
+        width = qBound(minWidth, width, maxWidth);
+        height = qBound(minHeight, height, maxHeight);
+    }
+    if (width == DisplayWidth(dpy, screen) &&
+        height == DisplayHeight(dpy, screen)) { return; }
+
+    // keep the current dpi
+    int mmWidth = (int)((double)width * DisplayWidthMM(dpy, screen) / DisplayWidth(dpy, screen));
+    int mmHeight = (int)((double)height * DisplayHeightMM(dpy, screen) / DisplayHeight(dpy, screen));
+    qDebug() << "resize screen" << width << height;
+    XRRSetScreenSize(dpy, root, width, height, mmWidth, mmHeight);
+}
+
+// fit the screen to the active crtcs, crtc is about to cover width x height
+static void resizeScreen(Display *dpy,
+                         XRRScreenResources *sr,
+                         RRCrtc crtc,
+                         int width,
+                         int height)
+{
+    for (int i = 0; i < sr->ncrtc; ++i) {
+        if (sr->crtcs[i] == crtc) { continue; }
+        XRRCrtcInfo *info = XRRGetCrtcInfo(dpy, sr, sr->crtcs[i]);
+        if (!info) { continue; }
+        if (info->mode != None) {
+            width = qMax(width, info->x + (int)info->width);
+            height = qMax(height, info->y + (int)info->height);
+        }
+        XRRFreeCrtcInfo(info);
+    }
+    setScreenSize(dpy, width, height);
+}
+
+RandR::RandR(QObject *parent)
+    : QObject(parent)
+    , hasRandR(false)
+    , randrEventBase(0)
+    , edidAtom(0)
+    , connectorAtom(0)
+{
+    // a hotplug usually comes as a burst of events, refresh once
+    updateTimer.setSingleShot(true);
+    updateTimer.setInterval(0);
+    connect(&updateTimer, SIGNAL(timeout()),
+            this, SLOT(update()));
+    connect(X11::instance(), SIGNAL(connected()),
+            this, SLOT(setup()));
+    connect(X11::instance(), SIGNAL(disconnected()),
+            this, SLOT(clear()));
+    connect(X11::instance(), SIGNAL(eventReceived(_XEvent*)),
+            this, SLOT(handleEvent(_XEvent*)));
+    setup();
+}
+
+const QMap<QString, RandR::Output> RandR::getOutputs()
+{
+    return outputs;
+}
+
+const QString RandR::getInternalOutput()
+{
+    return internal;
+}
+
+void RandR::setup()
+{
+    Display *dpy = X11::instance()->display();
+    if (!dpy) { return; }
+
+    int randrErrorBase;
+    hasRandR = XRRQueryExtension(dpy, &randrEventBase, &randrErrorBase);
+    if (!hasRandR) {
+        qWarning() << "RandR extension not available";
+        return;
+    }
+    edidAtom = XInternAtom(dpy, RR_PROPERTY_RANDR_EDID, False);
+    connectorAtom = XInternAtom(dpy, RR_PROPERTY_CONNECTOR_TYPE, False);
+    XRRSelectInput(dpy,
+                   DefaultRootWindow(dpy),
+                   RRScreenChangeNotifyMask | RROutputChangeNotifyMask);
+    update();
+}
+
+void RandR::clear()
+{
+    hasRandR = false;
+    outputs.clear();
+    order.clear();
+    internal.clear();
+    emit outputsChanged();
+}
+
+void RandR::handleEvent(_XEvent *event)
+{
+    if (!hasRandR) { return; }
+    if (event->type == randrEventBase + RRScreenChangeNotify) {
+        XRRUpdateConfiguration(event);
+        updateTimer.start();
+    } else if (event->type == randrEventBase + RRNotify) {
+        XRRNotifyEvent *notify = reinterpret_cast<XRRNotifyEvent*>(event);
+        if (notify->subtype == RRNotify_OutputChange) { updateTimer.start(); }
+    }
+}
+
+void RandR::update()
+{
+    Display *dpy = X11::instance()->display();
+    if (!dpy || !hasRandR) { return; }
+
+    QMap<QString, Output> result;
+    QStringList names;
+    XRRScreenResources *sr = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
+    if (sr) {
+        for (int i = 0; i < sr->noutput; ++i) {
+            XRROutputInfo *info = XRRGetOutputInfo(dpy, sr, sr->outputs[i]);
+            if (!info) { continue; }
+            Output output;
+            output.id = sr->outputs[i];
+            output.crtc = info->crtc;
+            output.name = QString::fromUtf8(info->name, info->nameLen);
+            output.connected = (info->connection == RR_Connected);
+            if (output.connected) {
+                output.connector = getConnectorType(output.id);
+                output.edid = getEdidHash(output.id);
+            }
+            if (info->nmode > 0) {
+                output.preferred = info->modes[0];
+                getModeSize(sr, output.preferred, RR_Rotate_0,
+                            &output.preferredWidth, &output.preferredHeight);
+            }
+            if (output.crtc) {
+                XRRCrtcInfo *crtcInfo = XRRGetCrtcInfo(dpy, sr, output.crtc);
+                if (crtcInfo) {
+                    output.mode = crtcInfo->mode;
+                    output.rotation = crtcInfo->rotation;
+                    output.x = crtcInfo->x;
+                    output.y = crtcInfo->y;
+                    output.width = crtcInfo->width;
+                    output.height = crtcInfo->height;
+                    XRRFreeCrtcInfo(crtcInfo);
+                }
+            }
+            XRRFreeOutputInfo(info);
+            result[output.name] = output;
+            names << output.name;
+        }
+        XRRFreeScreenResources(sr);
+    }
+    X11::instance()->flush();
+
+    QString panel = findInternalOutput(result, names);
+    if (!panel.isEmpty()) { result[panel].internal = true; }
+    if (panel != internal) { qDebug() << "internal output is now" << panel; }
+
+    outputs = result;
+    order = names;
+    internal = panel;
+    qDebug() << "randr outputs updated" << order;
+    emit outputsChanged();
+}
+
+const QString RandR::findInternalOutput(const QMap<QString, Output> &result,
+                                        const QStringList &names)
+{
+    // the connector type is authoritative, drivers that don't set it
+    // use well known names for built-in panels
+    QStringList panels;
+    const QStringList prefixes = PK_RANDR_PANEL_NAMES;
+    for (int i = 0; i < names.size(); ++i) {
+        const Output output = result.value(names.at(i));
+        bool isPanel = output.connector == PK_RANDR_CONNECTOR_PANEL;
+        for (int j = 0; j < prefixes.size() && !isPanel; ++j) {
+            if (output.name.startsWith(prefixes.at(j), Qt::CaseInsensitive)) { isPanel = true; }
+        }
+        if (!isPanel) { continue; }
+        if (output.connected) { panels.prepend(output.name); } else { panels.append(output.name); }
+    }
+    if (!panels.isEmpty()) {
+        const QString edid = result.value(panels.first()).edid;
+        if (!edid.isEmpty()) { internalEdid = edid; }
+        return panels.first();
+    }
+
+    // the panel we saw earlier might show up under another name
+    if (!internalEdid.isEmpty()) {
+        for (int i = 0; i < names.size(); ++i) {
+            if (result.value(names.at(i)).edid == internalEdid) { return names.at(i); }
+        }
+    }
+
+    // guessing would treat an external monitor as the panel
+    if (!names.isEmpty()) { qWarning() << "unable to identify the internal output"; }
+    return QString();
+}
+
+const QString RandR::getConnectorType(unsigned long output)
+{
+    QString result;
+    Display *dpy = X11::instance()->display();
+    if (!dpy || !connectorAtom) { return result; }
+
+    Atom actualType;
+    int actualFormat;
+    unsigned long items, bytesAfter;
+    unsigned char *prop = nullptr;
+    if (XRRGetOutputProperty(dpy, output, connectorAtom, 0, 1,
+                             False, False, AnyPropertyType,
+                             &actualType, &actualFormat,
+                             &items, &bytesAfter, &prop) == Success) {
+        if (prop && actualType == XA_ATOM && actualFormat == 32 && items == 1) {
+            char *name = XGetAtomName(dpy, *reinterpret_cast<Atom*>(prop));
+            if (name) {
+                result = QString::fromUtf8(name);
+                XFree(name);
+            }
+        }
+        if (prop) { XFree(prop); }
+    }
+    return result;
+}
+
+const QString RandR::getEdidHash(unsigned long output)
+{
+    QString result;
+    Display *dpy = X11::instance()->display();
+    if (!dpy || !edidAtom) { return result; }
+
+    Atom actualType;
+    int actualFormat;
+    unsigned long items, bytesAfter;
+    unsigned char *prop = nullptr;
+    if (XRRGetOutputProperty(dpy, output, edidAtom, 0, PK_RANDR_EDID_LENGTH,
+                             False, False, AnyPropertyType,
+                             &actualType, &actualFormat,
+                             &items, &bytesAfter, &prop) == Success) {
+        if (prop && actualType == XA_INTEGER && actualFormat == 8 && items > 0) {
+            QByteArray edid(reinterpret_cast<const char*>(prop), (int)items);
+            result = QString::fromLatin1(QCryptographicHash::hash(edid,
+                                                                  QCryptographicHash::Sha1).toHex());
+        }
+        if (prop) { XFree(prop); }
+    }
+    return result;
+}
+
+bool RandR::setOutputEnabled(const QString &name,
+                             bool enabled)
+{
+    Display *dpy = X11::instance()->display();
+    if (!dpy || !hasRandR || !outputs.contains(name)) {
+        qWarning() << "unable to switch output" << name;
+        emit outputSwitched(name, enabled, false);
+        return false;
+    }
+
+    qDebug() << "switch output" << name << enabled;
+    RROutput output = outputs.value(name).id;
+    XRRScreenResources *sr = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
+    XRROutputInfo *info = sr ? XRRGetOutputInfo(dpy, sr, output) : nullptr;
+    bool ok = false;
+    if (info) {
+        XGrabServer(dpy);
+        X11::instance()->trapErrors();
+        if (!enabled && info->crtc) {
+            XRRCrtcInfo *crtcInfo = XRRGetCrtcInfo(dpy, sr, info->crtc);
+            if (crtcInfo) {
+                CrtcState state;
+                state.crtc = info->crtc;
+                state.mode = crtcInfo->mode;
+                state.x = crtcInfo->x;
+                state.y = crtcInfo->y;
+                state.rotation = crtcInfo->rotation;
+                saved[name] = state;
+
+                // leave any clones on the same crtc running
+                QVector<RROutput> clones;
+                for (int i = 0; i < crtcInfo->noutput; ++i) {
+                    if (crtcInfo->outputs[i] != output) { clones << crtcInfo->outputs[i]; }
+                }
+                bool off = clones.isEmpty();
+                ok = XRRSetCrtcConfig(dpy, sr, state.crtc, CurrentTime,
+                                      off ? 0 : state.x,
+                                      off ? 0 : state.y,
+                                      off ? None : state.mode,
+                                      off ? RR_Rotate_0 : state.rotation,
+                                      off ? nullptr : clones.data(),
+                                      clones.size()) == RRSetConfigSuccess;
+                if (ok && off) { resizeScreen(dpy, sr, state.crtc, 0, 0); }
+                XRRFreeCrtcInfo(crtcInfo);
+            }
+        } else if (enabled && !info->crtc) {
+            CrtcState state = saved.value(name);
+
+            // prefer the crtc we had, if it's still free
+            RRCrtc crtc = None;
+            for (int i = 0; i < info->ncrtc; ++i) {
+                XRRCrtcInfo *crtcInfo = XRRGetCrtcInfo(dpy, sr, info->crtcs[i]);
+                if (!crtcInfo) { continue; }
+                bool unused = crtcInfo->noutput == 0;
+                XRRFreeCrtcInfo(crtcInfo);
+                if (!unused) { continue; }
+                if (!crtc || info->crtcs[i] == state.crtc) { crtc = info->crtcs[i]; }
+            }
+
+            // same as xrandr --auto if the previous mode is gone
+            bool hasMode = false;
+            for (int i = 0; i < info->nmode; ++i) {
+                if (info->modes[i] == state.mode) { hasMode = true; }
+            }
+            if (!hasMode) {
+                state = CrtcState();
+                if (info->nmode > 0) { state.mode = info->modes[0]; }
+            }
+
+            if (crtc && state.mode) {
+                int width, height;
+                getModeSize(sr, state.mode, state.rotation, &width, &height);
+                resizeScreen(dpy, sr, crtc, state.x + width, state.y + height);
+                ok = XRRSetCrtcConfig(dpy, sr, crtc, CurrentTime,
+                                      state.x,
+                                      state.y,
+                                      state.mode,
+                                      state.rotation,
+                                      &output,
+                                      1) == RRSetConfigSuccess;
+                if (ok) { saved.remove(name); }
+            }
+        } else { ok = true; } // nothing to do
+        if (X11::instance()->untrapErrors() != Success) { ok = false; }
+        XUngrabServer(dpy);
+        XRRFreeOutputInfo(info);
+    }
+    if (sr) { XRRFreeScreenResources(sr); }
+    X11::instance()->flush();
+
+    if (!ok) { qWarning() << "failed to switch output" << name << enabled; }
+    emit outputSwitched(name, enabled, ok);
+    return ok;
+}
+
+bool RandR::setConfig(const QMap<QString, Config> &configs)
+{
+    Display *dpy = X11::instance()->display();
+    if (!dpy || !hasRandR) {
+        emit configApplied(false);
+        return false;
+    }
+
+    XRRScreenResources *sr = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
+    if (!sr) {
+        emit configApplied(false);
+        return false;
+    }
+
+    bool ok = true;
+    QMap<QString, XRROutputInfo*> infos;
+    QMapIterator<QString, Config> i(configs);
+    while (i.hasNext()) {
+        i.next();
+        if (!outputs.contains(i.key())) { continue; }
+        XRROutputInfo *info = XRRGetOutputInfo(dpy, sr, outputs.value(i.key()).id);
+        if (info) { infos[i.key()] = info; }
+    }
+
+    // enabled outputs keep their crtc, unless it's shared with another output
+    QMap<QString, RRCrtc> targets;
+    QVector<RRCrtc> used;
+    QMapIterator<QString, XRROutputInfo*> o(infos);
+    while (o.hasNext()) {
+        o.next();
+        if (!configs.value(o.key()).enabled ||
+            !o.value()->crtc ||
+            used.contains(o.value()->crtc)) { continue; }
+        targets[o.key()] = o.value()->crtc;
+        used << o.value()->crtc;
+    }
+    o.toFront();
+    while (o.hasNext()) {
+        o.next();
+        if (!configs.value(o.key()).enabled || targets.contains(o.key())) { continue; }
+        for (int c = 0; c < o.value()->ncrtc; ++c) {
+            RRCrtc crtc = o.value()->crtcs[c];
+            if (used.contains(crtc)) { continue; }
+            XRRCrtcInfo *crtcInfo = XRRGetCrtcInfo(dpy, sr, crtc);
+            if (!crtcInfo) { continue; }
+            bool unused = true;
+            for (int n = 0; n < crtcInfo->noutput; ++n) {
+                bool released = false;
+                QMapIterator<QString, XRROutputInfo*> r(infos);
+                while (r.hasNext()) {
+                    r.next();
+                    if (outputs.value(r.key()).id == crtcInfo->outputs[n] &&
+                        targets.value(r.key()) != crtc) { released = true; }
+                }
+                if (!released) { unused = false; }
+            }
+            XRRFreeCrtcInfo(crtcInfo);
+            if (!unused) { continue; }
+            targets[o.key()] = crtc;
+            used << crtc;
+            break;
+        }
+        if (!targets.contains(o.key())) {
+            qWarning() << "no crtc available for output" << o.key();
+            ok = false;
+        }
+    }
+
+    // the screen must cover every crtc that is left running
+    int width = 0;
+    int height = 0;
+    for (int c = 0; c < sr->ncrtc; ++c) {
+        bool configured = false;
+        QMapIterator<QString, XRROutputInfo*> r(infos);
+        while (r.hasNext()) {
+            r.next();
+            if (r.value()->crtc == sr->crtcs[c] || targets.value(r.key()) == sr->crtcs[c]) { configured = true; }
+        }
+        if (configured) { continue; }
+        XRRCrtcInfo *crtcInfo = XRRGetCrtcInfo(dpy, sr, sr->crtcs[c]);
+        if (!crtcInfo) { continue; }
+        if (crtcInfo->mode != None) {
+            width = qMax(width, crtcInfo->x + (int)crtcInfo->width);
+            height = qMax(height, crtcInfo->y + (int)crtcInfo->height);
+        }
+        XRRFreeCrtcInfo(crtcInfo);
+    }
+    QMapIterator<QString, RRCrtc> t(targets);
+    while (t.hasNext()) {
+        t.next();
+        const Config config = configs.value(t.key());
+        int modeWidth, modeHeight;
+        getModeSize(sr, config.mode, config.rotation, &modeWidth, &modeHeight);
+        width = qMax(width, config.x + modeWidth);
+        height = qMax(height, config.y + modeHeight);
+    }
+
+    XGrabServer(dpy);
+    X11::instance()->trapErrors();
+
+    // turn off what goes away, moves to another crtc or won't fit
+    o.toFront();
+    while (o.hasNext()) {
+        o.next();
+        RRCrtc crtc = o.value()->crtc;
+        if (!crtc) { continue; }
+        bool off = targets.value(o.key()) != crtc;
+        if (!off) {
+            XRRCrtcInfo *crtcInfo = XRRGetCrtcInfo(dpy, sr, crtc);
+            if (crtcInfo) {
+                off = crtcInfo->x + (int)crtcInfo->width > width ||
+                      crtcInfo->y + (int)crtcInfo->height > height;
+                XRRFreeCrtcInfo(crtcInfo);
+            }
+        }
+        if (!off) { continue; }
+        if (XRRSetCrtcConfig(dpy, sr, crtc, CurrentTime,
+                             0, 0, None, RR_Rotate_0,
+                             nullptr, 0) != RRSetConfigSuccess) { ok = false; }
+    }
+
+    if (width > 0 && height > 0) { setScreenSize(dpy, width, height); }
+
+    t.toFront();
+    while (t.hasNext()) {
+        t.next();
+        const Config config = configs.value(t.key());
+        RROutput output = outputs.value(t.key()).id;
+        XRRCrtcInfo *crtcInfo = XRRGetCrtcInfo(dpy, sr, t.value());
+        if (!crtcInfo) {
+            ok = false;
+            continue;
+        }
+        bool same = crtcInfo->mode == config.mode &&
+                    crtcInfo->x == config.x &&
+                    crtcInfo->y == config.y &&
+                    crtcInfo->rotation == config.rotation &&
+                    crtcInfo->noutput == 1 &&
+                    crtcInfo->outputs[0] == output;
+        XRRFreeCrtcInfo(crtcInfo);
+        if (same) { continue; }
+        qDebug() << "configure output" << t.key() << config.x << config.y;
+        if (XRRSetCrtcConfig(dpy, sr, t.value(), CurrentTime,
+                             config.x,
+                             config.y,
+                             config.mode,
+                             config.rotation,
+                             &output,
+                             1) != RRSetConfigSuccess) { ok = false; }
+    }
+
+    if (X11::instance()->untrapErrors() != Success) { ok = false; }
+    XUngrabServer(dpy);
+
+    QMapIterator<QString, XRROutputInfo*> f(infos);
+    while (f.hasNext()) {
+        f.next();
+        XRRFreeOutputInfo(f.value());
+    }
+    XRRFreeScreenResources(sr);
+    X11::instance()->flush();
+
+    if (!ok) { qWarning() << "failed to apply output configuration"; }
+    emit configApplied(ok);
+    return ok;
+}
@@ -0,0 +1,128 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef POWERKIT_RANDR_H
+#define POWERKIT_RANDR_H
+
+#include <QObject>
+#include <QTimer>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+union _XEvent;
+
+namespace PowerKit
+{
+    class RandR : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        struct Output
+        {
+            Output()
+                : id(0)
+                , crtc(0)
+                , connected(false)
+                , internal(false)
+                , mode(0)
+                , rotation(1)
+                , x(0)
+                , y(0)
+                , width(0)
+                , height(0)
+                , preferred(0)
+                , preferredWidth(0)
+                , preferredHeight(0) {}
+            unsigned long id;
+            unsigned long crtc;
+            QString name;
+            bool connected;
+            QString connector;
+            QString edid;
+            bool internal;
+            unsigned long mode;
+            unsigned short rotation;
+            int x;
+            int y;
+            int width;
+            int height;
+            unsigned long preferred;
+            int preferredWidth;
+            int preferredHeight;
+        };
+        struct Config
+        {
+            Config()
+                : enabled(false)
+                , mode(0)
+                , x(0)
+                , y(0)
+                , rotation(1) {}
+            bool enabled;
+            unsigned long mode;
+            int x;
+            int y;
+            unsigned short rotation;
+        };
+        explicit RandR(QObject *parent = nullptr);
+        const QMap<QString, Output> getOutputs();
+        const QString getInternalOutput();
+
+    private:
+        struct CrtcState
+        {
+            CrtcState()
+                : crtc(0)
+                , mode(0)
+                , x(0)
+                , y(0)
+                , rotation(1) {}
+            unsigned long crtc;
+            unsigned long mode;
+            int x;
+            int y;
+            unsigned short rotation;
+        };
+        bool hasRandR;
+        int randrEventBase;
+        unsigned long edidAtom;
+        unsigned long connectorAtom;
+        QMap<QString, Output> outputs;
+        QStringList order;
+        QString internal;
+        QString internalEdid;
+        QTimer updateTimer;
+        QMap<QString, CrtcState> saved;
+
+    signals:
+        void outputsChanged();
+        void outputSwitched(const QString &name,
+                            bool enabled,
+                            bool success);
+        void configApplied(bool success);
+
+    private slots:
+        void setup();
+        void clear();
+        void handleEvent(_XEvent *event);
+        void update();
+        const QString getConnectorType(unsigned long output);
+        const QString getEdidHash(unsigned long output);
+        const QString findInternalOutput(const QMap<QString, Output> &result,
+                                         const QStringList &names);
+
+    public slots:
+        bool setOutputEnabled(const QString &name,
+                              bool enabled);
+        bool setConfig(const QMap<QString, Config> &configs);
+    };
+}
+
+#endif // POWERKIT_RANDR_H
@@ -7,19 +7,19 @@
 */
 
 #include "powerkit_screensaver.h"
-#include <QMapIterator>
 #include <QDBusConnection>
 #include <QDBusInterface>
+#include <QDBusMessage>
 #include <QCoreApplication>
-#include <QProcess>
-#include <QRandomGenerator>
 #include <QDebug>
 
 #include "powerkit_common.h"
 #include "powerkit_settings.h"
+#include "powerkit_x11.h"
+#include "powerkit_locker.h"
 
 #include <X11/extensions/scrnsaver.h>
-#include <X11/extensions/Xrandr.h>
+#include <X11/extensions/dpms.h>
 
 // fix Xrandr
 #ifdef Bool
@@ -39,76 +39,82 @@
 //#undef Expose
 //#undef FrameFeature
 
-#define PK_SCREENSAVER_TIMER 10000
-#define PK_SCREENSAVER_MAX_INHIBIT 18000
+#define PK_SCREENSAVER_RESET_MARGIN 10
+#define PK_SCREENSAVER_MAX_INHIBIT 18000000 // msec
 #define PK_SCREENSAVER_ACTIVITY "SimulateUserActivity"
 
 using namespace PowerKit;
 
 ScreenSaver::ScreenSaver(QObject *parent)
     : QObject(parent)
+    , idleMonitor(nullptr)
+    , idleReset(0)
+    , inhibitors(nullptr)
     , blank(POWERKIT_SCREENSAVER_TIMEOUT_BLANK)
 {
-    timer.setInterval(PK_SCREENSAVER_TIMER);
-    connect(&timer, SIGNAL(timeout()),
-            this, SLOT(timeOut()));
-    timer.start();
+    inhibitors = new InhibitorRegistry(PK_SCREENSAVER_MAX_INHIBIT, this);
+    connect(inhibitors, SIGNAL(removed(quint32)),
+            this, SLOT(handleInhibitorRemoved(quint32)));
+    connect(inhibitors, SIGNAL(inhibitedChanged(bool)),
+            this, SLOT(handleInhibitedChanged(bool)));
+    idleMonitor = new IdleMonitor(this);
+    connect(idleMonitor, SIGNAL(timeoutReached(int,quint32)),
+            this, SLOT(handleIdleTimeout(int,quint32)));
     Update();
 }
 
-quint32 ScreenSaver::genCookie()
+InhibitorRegistry *ScreenSaver::getInhibitors()
 {
-    quint32 cookie = QRandomGenerator::global()->generate();
-    while (!clients.contains(cookie)) {
-        if (!clients.contains(cookie)) { clients[cookie] = QTime::currentTime(); }
-        else { cookie = QRandomGenerator::global()->generate(); }
-    }
-    return cookie;
+    return inhibitors;
 }
 
-void ScreenSaver::checkForExpiredClients()
+bool ScreenSaver::canInhibit()
 {
-    QMapIterator<quint32, QTime> client(clients);
-    while (client.hasNext()) {
-        client.next();
-        if (client.value()
-            .secsTo(QTime::currentTime()) >= PK_SCREENSAVER_MAX_INHIBIT) {
-            clients.remove(client.key());
-        }
-    }
+    return inhibitors->isInhibited();
 }
 
-bool ScreenSaver::canInhibit()
+void ScreenSaver::handleIdleTimeout(int id, quint32 msec)
 {
-    checkForExpiredClients();
-    if (clients.size() > 0) { return true; }
-    return false;
+    qDebug() << "screensaver idle timeout" << id << msec;
+    // reset idle before the X screen saver kicks in if inhibited
+    if (id == idleReset && canInhibit()) { SimulateUserActivity(); }
 }
 
-void ScreenSaver::timeOut()
+void ScreenSaver::handleInhibitorRemoved(quint32 cookie)
 {
-    if (canInhibit()) {
-        SimulateUserActivity();
-        return;
-    }
-    int idle = GetSessionIdleTime();
-    qDebug() << "screensaver idle" << idle << blank;
-    if (idle >= blank) { Lock(); }
+    emit removedInhibit(cookie);
+}
+
+void ScreenSaver::handleInhibitedChanged(bool inhibited)
+{
+    qDebug() << "screensaver inhibited?" << inhibited;
+    if (inhibited) { SimulateUserActivity(); }
+    emit inhibitedChanged(inhibited);
 }
 
 void ScreenSaver::Update()
 {
-    xlock = Settings::getValue(CONF_SCREENSAVER_LOCK_CMD,
-                               POWERKIT_SCREENSAVER_LOCK_CMD).toString();
-    blank = Settings::getValue(CONF_SCREENSAVER_TIMEOUT_BLANK,
-                               POWERKIT_SCREENSAVER_TIMEOUT_BLANK).toInt();
-    int exe1 = QProcess::execute("xset",
-                                 QStringList() << "-dpms");
-    int exe2 = QProcess::execute("xset",
-                                 QStringList() << "s" << "on");
-    int exe3 = QProcess::execute("xset",
-                                 QStringList() << "s" << QString::number(blank));
-    qDebug() << "screensaver update" << exe1 << exe2 << exe3;
+    xlock = Settings::getConfig().screensaverLockCmd;
+    blank = Settings::getConfig().screensaverBlankTimeout;
+    Display *dpy = X11::instance()->display();
+    if (dpy) {
+        int timeout, interval, preferBlanking, allowExposures;
+        XGetScreenSaver(dpy, &timeout, &interval, &preferBlanking, &allowExposures);
+        XSetScreenSaver(dpy, blank, interval, preferBlanking, allowExposures);
+        int dpmsEvent, dpmsError;
+        if (DPMSQueryExtension(dpy, &dpmsEvent, &dpmsError) && DPMSCapable(dpy)) {
+            DPMSDisable(dpy);
+        }
+        X11::instance()->flush();
+    }
+    qDebug() << "screensaver update" << blank;
+
+    idleMonitor->removeAllTimeouts();
+    idleReset = 0;
+    if (blank > 0) {
+        idleReset = idleMonitor->addTimeout(qMax(blank - PK_SCREENSAVER_RESET_MARGIN, 1) * 1000);
+    }
+
     SimulateUserActivity();
 }
 
@@ -116,32 +122,46 @@ void ScreenSaver::Lock()
 {
     if (xlock.isEmpty()) { return; }
     qDebug() << "screensaver lock";
-    QProcess::startDetached(xlock, QStringList());
+    Locker::instance()->lock(xlock);
     setDisplaysOff(true);
 }
 
+// lock and blank, but leave the monitors powered
+void ScreenSaver::Blank()
+{
+    if (!xlock.isEmpty()) {
+        qDebug() << "screensaver lock";
+        Locker::instance()->lock(xlock);
+    }
+    Display *dpy = X11::instance()->display();
+    if (!dpy) { return; }
+    XForceScreenSaver(dpy, ScreenSaverActive);
+    X11::instance()->flush();
+    qDebug() << "screensaver blank";
+}
+
 void ScreenSaver::SimulateUserActivity()
 {
-    int exe = QProcess::execute("xset",
-                                QStringList() << "s" << "reset");
-    qDebug() << "screensaver reset" << exe;
+    Display *dpy = X11::instance()->display();
+    if (!dpy) { return; }
+    XResetScreenSaver(dpy);
+    X11::instance()->flush();
+    qDebug() << "screensaver reset";
 }
 
 quint32 ScreenSaver::GetSessionIdleTime()
 {
     quint32 idle = 0;
-    Display *display = XOpenDisplay(0);
-    if (display != 0) {
-        XScreenSaverInfo *info = XScreenSaverAllocInfo();
-        XScreenSaverQueryInfo(display,
-                              DefaultRootWindow(display),
-                              info);
-        if (info) {
-            idle = info->idle;
-            XFree(info);
-        }
+    Display *display = X11::instance()->display();
+    if (!display) { return idle; }
+    XScreenSaverInfo *info = XScreenSaverAllocInfo();
+    if (info) {
+        if (XScreenSaverQueryInfo(display,
+                                  DefaultRootWindow(display),
+                                  info)) { idle = info->idle; }
+        XFree(info);
     }
-    XCloseDisplay(display);
+    X11::instance()->flush();
     quint32 secs = idle / 1000;
     return secs;
 }
@@ -149,70 +169,42 @@ quint32 ScreenSaver::GetSessionIdleTime()
 quint32 ScreenSaver::Inhibit(const QString &application_name,
                              const QString &reason_for_inhibit)
 {
-    quint32 cookie = genCookie();
+    quint32 cookie = inhibitors->add(application_name,
+                                     reason_for_inhibit,
+                                     calledFromDBus() ? message().service() : QString());
     emit newInhibit(application_name,
                     reason_for_inhibit,
                     cookie);
-    timeOut();
     return cookie;
 }
 
 void ScreenSaver::UnInhibit(quint32 cookie)
 {
-    if (clients.contains(cookie)) { clients.remove(cookie); }
-    timeOut();
-    emit removedInhibit(cookie);
+    inhibitors->remove(cookie);
 }
 
-const QMap<QString, bool> ScreenSaver::GetDisplays()
-{
-    QMap<QString, bool> result;
-    Display *dpy;
-    if ((dpy = XOpenDisplay(nullptr)) == nullptr) { return result; }
-    XRRScreenResources *sr;
-    XRROutputInfo *info;
-    sr = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
-    if (sr) {
-        for (int i = 0; i < sr->noutput;++i) {
-            info = XRRGetOutputInfo(dpy, sr, sr->outputs[i]);
-            if (info == nullptr) {
-                XRRFreeOutputInfo(info);
-                continue;
-            }
-            QString output = info->name;
-            result[output] = (info->connection == RR_Connected);
-            XRRFreeOutputInfo(info);
-        }
-    }
-    XRRFreeScreenResources(sr);
-    XCloseDisplay(dpy);
-    return result;
-}
-
-const QString ScreenSaver::GetInternalDisplay()
-{
-    QString result;
-    Display *dpy;
-    if ((dpy = XOpenDisplay(nullptr)) == nullptr) { return result; }
-    XRRScreenResources *sr;
-    sr = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
-    if (sr) {
-        XRROutputInfo *info = XRRGetOutputInfo(dpy, sr, sr->outputs[0]);
-        if (info) { result = info->name; }
-        XRRFreeOutputInfo(info);
+static void forceDisplayLevel(CARD16 level)
+{
+    Display *dpy = X11::instance()->display();
+    if (!dpy) { return; }
+    int dpmsEvent, dpmsError;
+    if (DPMSQueryExtension(dpy, &dpmsEvent, &dpmsError) && DPMSCapable(dpy)) {
+        // a DPMS level can only be forced while DPMS is enabled
+        DPMSEnable(dpy);
+        DPMSForceLevel(dpy, level);
+        if (level == DPMSModeOn) { DPMSDisable(dpy); }
     }
-    XRRFreeScreenResources(sr);
-    XCloseDisplay(dpy);
-    return result;
+    if (level == DPMSModeOn) { XResetScreenSaver(dpy); }
+    X11::instance()->flush();
+    qDebug() << "dpms force" << level;
 }
 
 void ScreenSaver::setDisplaysOff(bool off)
 {
-    int xset = QProcess::execute("xset",
-                                QStringList() << "dpms" << "force" << (off ? "off" : "on"));
-    if (!off) {
-        QProcess::execute("xset",
-                          QStringList() << "s" << "reset");
-    }
-    qDebug() << "xset dpms force" << off << xset;
+    forceDisplayLevel(off ? DPMSModeOff : DPMSModeOn);
+}
+
+void ScreenSaver::setDisplaysStandby()
+{
+    forceDisplayLevel(DPMSModeStandby);
 }
@@ -10,23 +10,26 @@
 #define POWERKIT_SCREENSAVER_H
 
 #include <QObject>
-#include <QTimer>
-#include <QTime>
-#include <QMap>
 #include <QString>
+#include <QDBusContext>
+
+#include "powerkit_idle.h"
+#include "powerkit_inhibitor.h"
 
 namespace PowerKit
 {
-    class ScreenSaver : public QObject
+    class ScreenSaver : public QObject, protected QDBusContext
     {
         Q_OBJECT
 
     public:
         explicit ScreenSaver(QObject *parent = NULL);
+        InhibitorRegistry *getInhibitors();
 
     private:
-        QTimer timer;
-        QMap<quint32, QTime> clients;
+        IdleMonitor *idleMonitor;
+        int idleReset;
+        InhibitorRegistry *inhibitors;
         int blank;
         QString xlock;
 
@@ -35,24 +38,25 @@ namespace PowerKit
                         const QString &reason_for_inhibit,
                         quint32 cookie);
         void removedInhibit(quint32 cookie);
+        void inhibitedChanged(bool inhibited);
 
     private slots:
-        quint32 genCookie();
-        void checkForExpiredClients();
         bool canInhibit();
-        void timeOut();
+        void handleIdleTimeout(int id, quint32 msec);
+        void handleInhibitorRemoved(quint32 cookie);
+        void handleInhibitedChanged(bool inhibited);
 
     public slots:
         void Update();
         void Lock();
+        void Blank();
         void SimulateUserActivity();
         quint32 GetSessionIdleTime();
         quint32 Inhibit(const QString &application_name,
                         const QString &reason_for_inhibit);
         void UnInhibit(quint32 cookie);
-        static const QMap<QString, bool> GetDisplays();
-        static const QString GetInternalDisplay();
         static void setDisplaysOff(bool off);
+        static void setDisplaysStandby();
     };
 }
 
@@ -11,6 +11,7 @@
 #include <QFile>
 #include <QDir>
 #include <QSettings>
+#include <QHash>
 #include <QDebug>
 
 #include "powerkit_common.h"
@@ -19,71 +20,189 @@
 
 using namespace PowerKit;
 
-void Settings::setValue(const QString &type,
-                        const QVariant &value)
+// snapshot of powerkit.conf, lookups never touch the file
+static QHash<QString, QVariant> cache;
+static bool cacheLoaded = false;
+
+// keys staged by an open transaction
+static QHash<QString, QVariant> pending;
+static int transactions = 0;
+
+static Config typed;
+
+static int parseValue(const char *key,
+                      const QVariant &value,
+                      int fallback,
+                      int min,
+                      int max)
+{
+    bool ok = false;
+    int result = value.toInt(&ok);
+    if (!ok) {
+        qWarning() << "config:" << key << "is not a number:"
+                   << value.toString() << "using" << fallback;
+        return fallback;
+    }
+    if (result < min || result > max) {
+        qWarning() << "config:" << key << result << "is out of range"
+                   << QString("[%1,%2]").arg(min).arg(max) << "using" << fallback;
+        return fallback;
+    }
+    return result;
+}
+
+static bool parseValue(const char *key,
+                       const QVariant &value,
+                       bool fallback,
+                       int min,
+                       int max)
+{
+    Q_UNUSED(min)
+    Q_UNUSED(max)
+    const QString text = value.toString().toLower();
+    if (text == "true" || text == "1") { return true; }
+    if (text == "false" || text == "0") { return false; }
+    qWarning() << "config:" << key << "is not a boolean:"
+               << value.toString() << "using" << fallback;
+    return fallback;
+}
+
+static const QString parseValue(const char *key,
+                                const QVariant &value,
+                                const QString &fallback,
+                                int min,
+                                int max)
+{
+    Q_UNUSED(key)
+    Q_UNUSED(min)
+    Q_UNUSED(max)
+    if (!value.isValid()) { return fallback; }
+    return value.toString();
+}
+
+// one lookup per schema key, missing keys get their default
+static void parseConfig()
+{
+    QHash<QString, QVariant>::const_iterator it;
+#define PK_CONFIG_PARSE(type, name, key, def, min, max) \
+    it = cache.constFind(key); \
+    typed.name = it == cache.constEnd() ? type(def) \
+                                        : parseValue(key, it.value(), type(def), min, max);
+    POWERKIT_SETTINGS(PK_CONFIG_PARSE)
+#undef PK_CONFIG_PARSE
+}
+
+static void loadCache()
+{
+    QSettings settings(PK, PK);
+    cache.clear();
+    const QStringList keys = settings.allKeys();
+    cache.reserve(keys.size());
+    for (int i = 0; i < keys.size(); ++i) {
+        cache.insert(keys.at(i), settings.value(keys.at(i)));
+    }
+    cacheLoaded = true;
+    parseConfig();
+}
+
+// apply staged keys and write them with a single sync, QSettings
+// merges with keys written by other processes and saves atomically
+static bool writeKeys(const QHash<QString, QVariant> &keys)
 {
     QSettings settings(PK, PK);
-    settings.setValue(type, value);
+    QHash<QString, QVariant>::const_iterator it = keys.constBegin();
+    while (it != keys.constEnd()) {
+        settings.setValue(it.key(), it.value());
+        ++it;
+    }
     settings.sync();
+    if (settings.status() != QSettings::NoError) {
+        qWarning() << "failed to write settings" << settings.fileName();
+        return false;
+    }
+    return true;
+}
+
+void Settings::setValue(const QString &type,
+                        const QVariant &value)
+{
+    beginTransaction();
+    pending.insert(type, value);
+    commitTransaction();
 }
 
 const QVariant Settings::getValue(const QString &type,
                                   const QVariant &fallback)
 {
-    QSettings settings(PK, PK);
-    return settings.value(type, fallback);
+    if (!cacheLoaded) { loadCache(); }
+    QHash<QString, QVariant>::const_iterator it = cache.constFind(type);
+    if (it == cache.constEnd()) { return fallback; }
+    return it.value();
 }
 
 bool Settings::isValid(const QString &type)
 {
-    QSettings settings(PK, PK);
-    return settings.value(type).isValid();
+    if (!cacheLoaded) { loadCache(); }
+    return cache.value(type).isValid();
+}
+
+const Config &Settings::getConfig()
+{
+    if (!cacheLoaded) { loadCache(); }
+    return typed;
+}
+
+// refresh the snapshot, returns keys that differ from the last one
+const QStringList Settings::reload()
+{
+    QHash<QString, QVariant> previous = cache;
+    bool wasLoaded = cacheLoaded;
+    loadCache();
+    if (!wasLoaded) { return cache.keys(); }
+    QStringList changed;
+    QHash<QString, QVariant>::const_iterator it = cache.constBegin();
+    while (it != cache.constEnd()) {
+        if (!previous.contains(it.key()) ||
+            previous.value(it.key()) != it.value()) { changed << it.key(); }
+        ++it;
+    }
+    it = previous.constBegin();
+    while (it != previous.constEnd()) {
+        if (!cache.contains(it.key())) { changed << it.key(); }
+        ++it;
+    }
+    return changed;
+}
+
+void Settings::beginTransaction()
+{
+    transactions++;
+}
+
+bool Settings::commitTransaction()
+{
+    if (transactions < 1) { return false; }
+    if (--transactions > 0 || pending.isEmpty()) { return true; }
+    if (!cacheLoaded) { loadCache(); }
+    QHash<QString, QVariant>::const_iterator it = pending.constBegin();
+    while (it != pending.constEnd()) {
+        cache.insert(it.key(), it.value());
+        ++it;
+    }
+    parseConfig();
+    bool written = writeKeys(pending);
+    pending.clear();
+    return written;
 }
 
 void Settings::saveDefault()
 {
-    setValue(CONF_LID_BATTERY_ACTION,
-                      POWERKIT_LID_BATTERY_ACTION);
-    setValue(CONF_LID_AC_ACTION,
-                      POWERKIT_LID_AC_ACTION);
-    setValue(CONF_CRITICAL_BATTERY_ACTION,
-                      POWERKIT_CRITICAL_ACTION);
-    setValue(CONF_CRITICAL_BATTERY_TIMEOUT,
-                      POWERKIT_CRITICAL_BATTERY);
-    setValue(CONF_SUSPEND_BATTERY_TIMEOUT,
-                      POWERKIT_AUTO_SLEEP_BATTERY);
-    setValue(CONF_TRAY_NOTIFY,
-                      true);
-    setValue(CONF_TRAY_SHOW,
-                      true);
-    setValue(CONF_LID_DISABLE_IF_EXTERNAL,
-                      false);
-    setValue(CONF_SUSPEND_BATTERY_ACTION,
-                      suspendSleep);
-    setValue(CONF_SUSPEND_AC_ACTION,
-                      suspendNone);
-    setValue(CONF_BACKLIGHT_BATTERY_ENABLE,
-                      false);
-    setValue(CONF_BACKLIGHT_AC_ENABLE,
-                      false);
-    setValue(CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER,
-                      false);
-    setValue(CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER,
-                      false);
-    setValue(CONF_WARN_ON_LOW_BATTERY,
-                      true);
-    setValue(CONF_WARN_ON_VERYLOW_BATTERY,
-                      true);
-    setValue(CONF_NOTIFY_ON_BATTERY,
-                      true);
-    setValue(CONF_NOTIFY_ON_AC,
-                      true);
-    setValue(CONF_BACKLIGHT_MOUSE_WHEEL,
-                      true);
-    setValue(CONF_SUSPEND_LOCK_SCREEN,
-                      true);
-    setValue(CONF_RESUME_LOCK_SCREEN,
-                      false);
+    beginTransaction();
+#define PK_CONFIG_DEFAULT(type, name, key, def, min, max) \
+    setValue(key, type(def));
+    POWERKIT_SETTINGS(PK_CONFIG_DEFAULT)
+#undef PK_CONFIG_DEFAULT
+    commitTransaction();
 }
 
 const QString Settings::getConf()
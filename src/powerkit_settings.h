@@ -11,6 +11,9 @@
 
 #include <QVariant>
 #include <QString>
+#include <QStringList>
+
+#include "powerkit_common.h"
 
 #define CONF_DIALOG_GEOMETRY "dialog_geometry"
 #define CONF_SUSPEND_BATTERY_TIMEOUT "suspend_battery_timeout"
@@ -27,13 +30,19 @@
 #define CONF_TRAY_NOTIFY "tray_notify"
 #define CONF_TRAY_SHOW "show_tray"
 #define CONF_LID_XRANDR "lid_xrandr_action"
-#define CONF_BACKLIGHT_BATTERY "backlight_battery_value"
+#define CONF_DISPLAY_LAYOUT "display_layout_auto"
+#define CONF_DISPLAY_LAYOUTS "display_layouts"
+#define CONF_BACKLIGHT_BATTERY "backlight_battery_value" // deprecated, hardware value
+#define CONF_BACKLIGHT_BATTERY_PERCENT "backlight_battery_percent"
 #define CONF_BACKLIGHT_BATTERY_ENABLE "backlight_battery_enable"
 #define CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER "backlight_battery_disable_if_lower"
-#define CONF_BACKLIGHT_AC "backlight_ac_value"
+#define CONF_BACKLIGHT_AC "backlight_ac_value" // deprecated, hardware value
+#define CONF_BACKLIGHT_AC_PERCENT "backlight_ac_percent"
 #define CONF_BACKLIGHT_AC_ENABLE "backlight_ac_enable"
 #define CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER "backlight_ac_disable_if_higher"
 #define CONF_BACKLIGHT_MOUSE_WHEEL "backlight_mouse_wheel"
+#define CONF_BACKLIGHT_AUTO "backlight_auto"
+#define CONF_BACKLIGHT_AUTO_OFFSET "backlight_auto_offset"
 #define CONF_DIALOG "dialog_geometry"
 #define CONF_WARN_ON_LOW_BATTERY "warn_on_low_battery"
 #define CONF_WARN_ON_VERYLOW_BATTERY "warn_on_verylow_battery"
@@ -47,9 +56,65 @@
 #define CONF_KERNEL_BYPASS "kernel_cmd_bypass"
 #define CONF_SCREENSAVER_LOCK_CMD "screensaver_lock_cmd"
 #define CONF_SCREENSAVER_TIMEOUT_BLANK "screensaver_blank_timeout"
+#define CONF_IDLE_DIM_TIMEOUT "idle_dim_timeout"
+#define CONF_IDLE_DIM_LEVEL "idle_dim_level"
+#define CONF_IDLE_STANDBY_TIMEOUT "idle_standby_timeout"
+#define CONF_IDLE_OFF_TIMEOUT "idle_off_timeout"
+
+// X(type, name, key, default, min, max), the range only applies to int
+#define POWERKIT_SETTINGS(X) \
+    X(int, suspendBatteryTimeout, CONF_SUSPEND_BATTERY_TIMEOUT, POWERKIT_AUTO_SLEEP_BATTERY, 0, 1440) \
+    X(int, suspendACTimeout, CONF_SUSPEND_AC_TIMEOUT, 0, 0, 1440) \
+    X(int, suspendBatteryAction, CONF_SUSPEND_BATTERY_ACTION, POWERKIT_SUSPEND_BATTERY_ACTION, \
+      PowerKit::suspendNone, PowerKit::suspendSleepHibernate) \
+    X(int, suspendACAction, CONF_SUSPEND_AC_ACTION, POWERKIT_SUSPEND_AC_ACTION, \
+      PowerKit::suspendNone, PowerKit::suspendSleepHibernate) \
+    X(int, criticalBattery, CONF_CRITICAL_BATTERY_TIMEOUT, POWERKIT_CRITICAL_BATTERY, 0, 100) \
+    X(int, criticalAction, CONF_CRITICAL_BATTERY_ACTION, POWERKIT_CRITICAL_ACTION, \
+      PowerKit::criticalNone, PowerKit::criticalSuspend) \
+    X(int, lidBatteryAction, CONF_LID_BATTERY_ACTION, POWERKIT_LID_BATTERY_ACTION, \
+      PowerKit::lidNone, PowerKit::lidSleepHibernate) \
+    X(int, lidACAction, CONF_LID_AC_ACTION, POWERKIT_LID_AC_ACTION, \
+      PowerKit::lidNone, PowerKit::lidSleepHibernate) \
+    X(bool, lidDisableIfExternal, CONF_LID_DISABLE_IF_EXTERNAL, false, 0, 0) \
+    X(bool, lidXrandr, CONF_LID_XRANDR, false, 0, 0) \
+    X(bool, displayLayout, CONF_DISPLAY_LAYOUT, false, 0, 0) \
+    X(bool, trayNotify, CONF_TRAY_NOTIFY, true, 0, 0) \
+    X(bool, trayShow, CONF_TRAY_SHOW, true, 0, 0) \
+    X(bool, backlightBatteryEnable, CONF_BACKLIGHT_BATTERY_ENABLE, false, 0, 0) \
+    X(int, backlightBatteryPercent, CONF_BACKLIGHT_BATTERY_PERCENT, 100, 1, 100) \
+    X(bool, backlightBatteryDisableIfLower, CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER, false, 0, 0) \
+    X(bool, backlightACEnable, CONF_BACKLIGHT_AC_ENABLE, false, 0, 0) \
+    X(int, backlightACPercent, CONF_BACKLIGHT_AC_PERCENT, 100, 1, 100) \
+    X(bool, backlightACDisableIfHigher, CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER, false, 0, 0) \
+    X(bool, backlightMouseWheel, CONF_BACKLIGHT_MOUSE_WHEEL, true, 0, 0) \
+    X(bool, backlightAuto, CONF_BACKLIGHT_AUTO, false, 0, 0) \
+    X(int, backlightAutoOffset, CONF_BACKLIGHT_AUTO_OFFSET, 0, -100, 100) \
+    X(bool, warnOnLowBattery, CONF_WARN_ON_LOW_BATTERY, true, 0, 0) \
+    X(bool, warnOnVeryLowBattery, CONF_WARN_ON_VERYLOW_BATTERY, true, 0, 0) \
+    X(bool, notifyOnBattery, CONF_NOTIFY_ON_BATTERY, true, 0, 0) \
+    X(bool, notifyOnAC, CONF_NOTIFY_ON_AC, true, 0, 0) \
+    X(bool, notifyNewInhibitor, CONF_NOTIFY_NEW_INHIBITOR, true, 0, 0) \
+    X(bool, suspendLockScreen, CONF_SUSPEND_LOCK_SCREEN, true, 0, 0) \
+    X(bool, resumeLockScreen, CONF_RESUME_LOCK_SCREEN, false, 0, 0) \
+    X(bool, kernelBypass, CONF_KERNEL_BYPASS, false, 0, 0) \
+    X(QString, screensaverLockCmd, CONF_SCREENSAVER_LOCK_CMD, POWERKIT_SCREENSAVER_LOCK_CMD, 0, 0) \
+    X(int, screensaverBlankTimeout, CONF_SCREENSAVER_TIMEOUT_BLANK, POWERKIT_SCREENSAVER_TIMEOUT_BLANK, 0, 86400) \
+    X(int, idleDimTimeout, CONF_IDLE_DIM_TIMEOUT, POWERKIT_IDLE_DIM_TIMEOUT, 0, 86400) \
+    X(int, idleDimLevel, CONF_IDLE_DIM_LEVEL, POWERKIT_IDLE_DIM_LEVEL, 1, 100) \
+    X(int, idleStandbyTimeout, CONF_IDLE_STANDBY_TIMEOUT, POWERKIT_IDLE_STANDBY_TIMEOUT, 0, 86400) \
+    X(int, idleOffTimeout, CONF_IDLE_OFF_TIMEOUT, -1, -1, 86400)
 
 namespace PowerKit
 {
+    // typed view of powerkit.conf, generated from POWERKIT_SETTINGS
+    struct Config
+    {
+#define PK_CONFIG_MEMBER(type, name, key, def, min, max) type name;
+        POWERKIT_SETTINGS(PK_CONFIG_MEMBER)
+#undef PK_CONFIG_MEMBER
+    };
+
     class Settings
     {
     public:
@@ -58,6 +123,10 @@ namespace PowerKit
         static const QVariant getValue(const QString &type,
                                        const QVariant &fallback = QVariant());
         static bool isValid(const QString &type);
+        static const Config &getConfig();
+        static const QStringList reload();
+        static void beginTransaction();
+        static bool commitTransaction();
         static void saveDefault();
         static const QString getConf();
         static const QString getDir();
@@ -0,0 +1,184 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "powerkit_x11.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <X11/Xlib.h>
+
+#define X11_RECONNECT_MIN 1000
+#define X11_RECONNECT_MAX 30000
+
+using namespace PowerKit;
+
+static bool x11ErrorTrap = false;
+static int x11LastError = 0;
+
+static int x11ErrorHandler(Display *dpy, XErrorEvent *error)
+{
+    Q_UNUSED(dpy)
+    if (x11ErrorTrap) {
+        x11LastError = error->error_code;
+        return 0;
+    }
+    qWarning() << "X11 error" << error->error_code
+               << "request" << error->request_code
+               << "minor" << error->minor_code;
+    return 0;
+}
+
+// Reconnecting only survives every I/O error with libX11 >= 1.7. Older
+// versions exit() from inside Xlib, we can only catch a hangup that we
+// see on the socket before Xlib does.
+#ifdef HAVE_XSETIOERROREXITHANDLER
+static void x11IOErrorExitHandler(Display *dpy, void *data)
+{
+    Q_UNUSED(dpy)
+    // don't let Xlib exit() on us, drop the connection and reconnect later
+    QMetaObject::invokeMethod(static_cast<X11*>(data),
+                              "disconnectDisplay",
+                              Qt::QueuedConnection,
+                              Q_ARG(bool, true));
+}
+#endif
+
+X11 *X11::instance()
+{
+    static X11 *x11 = nullptr;
+    if (!x11) { x11 = new X11(qApp); }
+    return x11;
+}
+
+X11::X11(QObject *parent)
+    : QObject(parent)
+    , dpy(nullptr)
+    , notifier(nullptr)
+    , reconnectDelay(X11_RECONNECT_MIN)
+{
+    reconnectTimer.setSingleShot(true);
+    connect(&reconnectTimer, SIGNAL(timeout()),
+            this, SLOT(connectDisplay()));
+    XSetErrorHandler(x11ErrorHandler);
+    connectDisplay();
+}
+
+X11::~X11()
+{
+    disconnectDisplay(false);
+}
+
+Display *X11::display()
+{
+    return dpy;
+}
+
+unsigned long X11::rootWindow()
+{
+    if (!dpy) { return 0; }
+    return DefaultRootWindow(dpy);
+}
+
+bool X11::isConnected()
+{
+    return dpy != nullptr;
+}
+
+void X11::trapErrors()
+{
+    x11LastError = 0;
+    x11ErrorTrap = true;
+}
+
+int X11::untrapErrors()
+{
+    if (dpy) { XSync(dpy, False); }
+    x11ErrorTrap = false;
+    return x11LastError;
+}
+
+bool X11::connectDisplay()
+{
+    if (dpy) { return true; }
+    dpy = XOpenDisplay(nullptr);
+    if (!dpy) {
+        qWarning() << "unable to connect to the X server, retry in" << reconnectDelay;
+        reconnectTimer.start(reconnectDelay);
+        reconnectDelay = qMin(reconnectDelay * 2, X11_RECONNECT_MAX);
+        return false;
+    }
+#ifdef HAVE_XSETIOERROREXITHANDLER
+    XSetIOErrorExitHandler(dpy, x11IOErrorExitHandler, this);
+#endif
+    reconnectDelay = X11_RECONNECT_MIN;
+    notifier = new QSocketNotifier(ConnectionNumber(dpy),
+                                   QSocketNotifier::Read,
+                                   this);
+    connect(notifier, SIGNAL(activated(int)),
+            this, SLOT(processEvents()));
+    qDebug() << "connected to X server" << DisplayString(dpy);
+    emit connected();
+    return true;
+}
+
+void X11::disconnectDisplay(bool lost)
+{
+    if (!dpy) { return; }
+    if (notifier) {
+        notifier->setEnabled(false);
+        notifier->deleteLater();
+        notifier = nullptr;
+    }
+#ifdef HAVE_XSETIOERROREXITHANDLER
+    XCloseDisplay(dpy);
+#else
+    // closing a dead connection would make Xlib call exit(),
+    // release the socket and leave the Display behind instead
+    if (lost) { ::close(ConnectionNumber(dpy)); }
+    else { XCloseDisplay(dpy); }
+#endif
+    dpy = nullptr;
+    if (lost) {
+        qWarning() << "lost connection to the X server";
+        emit disconnected();
+        reconnectTimer.start(reconnectDelay);
+    }
+}
+
+void X11::processEvents()
+{
+    if (!dpy) { return; }
+    char byte;
+    ssize_t peek = recv(ConnectionNumber(dpy), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (peek == 0 ||
+        (peek < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        disconnectDisplay(true);
+        return;
+    }
+    XEventsQueued(dpy, QueuedAfterReading);
+    while (dpy && XPending(dpy) > 0) {
+        XEvent event;
+        XNextEvent(dpy, &event);
+        emit eventReceived(&event);
+    }
+}
+
+void X11::flush()
+{
+    if (!dpy) { return; }
+    XFlush(dpy);
+    // replies may have pulled events into the queue behind the notifier's back
+    if (XEventsQueued(dpy, QueuedAlready) > 0) {
+        QMetaObject::invokeMethod(this, "processEvents", Qt::QueuedConnection);
+    }
+}
@@ -0,0 +1,56 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) Ole-André Rodlie <https://github.com/rodlie> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef POWERKIT_X11_H
+#define POWERKIT_X11_H
+
+#include <QObject>
+#include <QSocketNotifier>
+#include <QTimer>
+
+typedef struct _XDisplay Display;
+union _XEvent;
+
+namespace PowerKit
+{
+    class X11 : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        static X11 *instance();
+        Display *display();
+        unsigned long rootWindow();
+        bool isConnected();
+        void trapErrors();
+        int untrapErrors();
+
+    private:
+        explicit X11(QObject *parent = nullptr);
+        ~X11();
+        Display *dpy;
+        QSocketNotifier *notifier;
+        QTimer reconnectTimer;
+        int reconnectDelay;
+
+    signals:
+        void connected();
+        void disconnected();
+        void eventReceived(_XEvent *event);
+
+    private slots:
+        bool connectDisplay();
+        void disconnectDisplay(bool lost);
+        void processEvents();
+
+    public slots:
+        void flush();
+    };
+}
+
+#endif // POWERKIT_X11_H